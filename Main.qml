@@ -2,6 +2,7 @@ import QtQuick
 import QtQuick.Window
 import QtQuick.Controls
 import QtQuick.Layouts
+import QtQuick.Dialogs
 
 import Qt.labs.qmlmodels
 
@@ -26,33 +27,30 @@ ApplicationWindow {
     
     CameraDiscovery {
         id: disocvery
+        continuous: true
         onDiscoveryStart: {
-            cameraStatus.text='Connecting...'
-            cameraDrawer.open()
+            if (!continuous)
+                cameraStatus.text='Connecting...'
         }
         onDiscoveryStop: (devices) => {
+                             if (continuous)
+                                 return;
                              if (devices==0) {
                                  cameraStatus.text="No cameras found!"
                                  //cameraDrawer.close()
                                  return;
                              }
                              cameraStatus.text="Found "+devices
-                             var d=getDevices();
-                             deviceList.model=d;
                          }
     }
     
-    ListModel {
-        id: deviceModel
-    }
-    
     Drawer {
         id: cameraDrawer
         height: parent.height
         width: parent.width/2
         interactive: false
         modal: true
-        closePolicy: disocvery.discovering ? Popup.NoAutoClose : (Popup.CloseOnEscape | Popup.CloseOnPressOutside)
+        closePolicy: Popup.CloseOnEscape | Popup.CloseOnPressOutside
         
         ColumnLayout {
             anchors.fill: parent
@@ -63,18 +61,23 @@ ApplicationWindow {
             }
             ListView {
                 id: deviceList
-                enabled: !disocvery.discovering
+                model: disocvery
                 Layout.fillHeight: true
                 Layout.fillWidth: true
                 delegate: ItemDelegate {
-                    text: modelData.name+" ("+modelData.address+")"
-                    font.italic: modelData.rssi==0 ? true : false
-                    enabled: modelData.rssi!=0
+                    required property int index
+                    required property string name
+                    required property string address
+                    required property int rssi
+                    text: name+" ("+address+")"
+                    font.italic: rssi==0 ? true : false
+                    enabled: rssi!=0
                     onClicked: {
-                        var device=disocvery.getBluetoothDevice(modelData.address);
+                        var device=disocvery.getBluetoothDevice(address);
                         console.debug(device)
                         deviceList.currentIndex=index;
-                        cd.connectDevice(device)
+                        disocvery.stopDeviceDiscovery()
+                        cameras.connectCamera(device)
                         cameraDrawer.close()
                     }
                 }
@@ -87,7 +90,6 @@ ApplicationWindow {
                     onClicked: disocvery.startDeviceDiscovery()
                 }
                 Button {
-                    enabled: !disocvery.discovering
                     text: "Close"
                     onClicked: {
                         cameraDrawer.close()
@@ -99,7 +101,7 @@ ApplicationWindow {
         BusyIndicator {
             id: discoveringProgress
             anchors.centerIn: parent
-            visible: disocvery.discovering
+            visible: disocvery.discovering && disocvery.count==0
         }
 
         Label {
@@ -109,12 +111,20 @@ ApplicationWindow {
         }
     }
     
-    CameraDevice {
-        id: cd
-        
-        onStatusChanged: {
-            console.debug("CameraStatus is now: "+status)
-            switch (status) {
+    CameraManager {
+        id: cameras
+        discovery: disocvery
+    }
+
+    property CameraDevice cd: cameras.current
+    property bool connectionReady: cd.connected && cd.status==3
+
+    Connections {
+        target: cd
+
+        function onStatusChanged() {
+            console.debug("CameraStatus is now: "+cd.status)
+            switch (cd.status) {
             case 1:
                 cameraStatus.text="Connected"
                 break;
@@ -123,43 +133,46 @@ ApplicationWindow {
                 break;
             }
         }
-        
-        onAutoFocusTriggered: {
+
+        function onAutoFocusTriggered() {
             console.debug("Autofocusing...")
             setTimedMessage('AutoFocus');
         }
-        
-        onIsoChanged: {
-            console.debug("ISO is:"+iso)
-            comboISO.currentIndex=comboISO.indexOfValue(iso)
+
+        function onIsoChanged() {
+            console.debug("ISO is:"+cd.iso)
+            comboISO.currentIndex=comboISO.indexOfValue(cd.iso)
         }
-        
-        onShutterSpeedChanged: {
-            console.debug("shutterSpeed is:"+shutterSpeed)
-            comboShutter.currentIndex=comboShutter.indexOfValue(shutterSpeed)
+
+        function onShutterSpeedChanged() {
+            console.debug("shutterSpeed is:"+cd.shutterSpeed)
+            comboShutter.currentIndex=comboShutter.indexOfValue(cd.shutterSpeed)
         }
-        
-        onApertureChanged: {
+
+        function onApertureChanged() {
             console.debug("Aperture is: "+cd.aperture)
             let tmp=cd.aperture.toFixed(1);
             console.log(tmp)
             comboAperture.currentIndex=comboAperture.indexOfValue(tmp)
         }
-        
-        onWbChanged: {
-            console.debug("WB is:"+wb)
-            comboWB.currentIndex=comboWB.indexOfValue(wb)
+
+        function onWbChanged() {
+            console.debug("WB is:"+cd.wb)
+            comboWB.currentIndex=comboWB.indexOfValue(cd.wb)
         }
-        
-        onTintChanged: {
-            spinTint.value=tint
+
+        function onTintChanged() {
+            spinTint.value=cd.tint
         }
-        
-        onConnectionFailure: {
+
+        function onConnectionFailure() {
             cameraStatus.text="Failed to connect"
         }
-        
-        property bool connectionReady: cd.connected && cd.status==3
+
+        function onConnectionStateChanged() {
+            if (cd.connectionState==CameraDevice.Reconnecting)
+                cameraStatus.text="Reconnecting..."
+        }
     }
     
     Action {
@@ -179,7 +192,7 @@ ApplicationWindow {
         standardButtons: Dialog.Ok | Dialog.Cancel
         modal: true
         onAccepted: {
-            cd.disconnectFromDevice()
+            cameras.disconnectAll()
             Qt.quit()
         }
     }
@@ -191,12 +204,12 @@ ApplicationWindow {
             title: "&File"
             MenuItem {
                 text: "&Slate"
-                enabled: cd.connectionReady
+                enabled: connectionReady
                 onClicked: slateDrawer.open()
             }
             MenuItem {
                 text: "&Play mode"
-                enabled: cd.connectionReady && !cd.recording && !cd.playing
+                enabled: connectionReady && !cd.recording && !cd.playing
                 onClicked: cd.play(true);
             }
             MenuItem {
@@ -209,7 +222,7 @@ ApplicationWindow {
             MenuItem {
                 text: "&Quit"
                 onClicked: {
-                    if (!cd.connected)
+                    if (!cameras.count)
                         Qt.quit()
                     else
                         quitDialog.open()
@@ -220,8 +233,11 @@ ApplicationWindow {
             title: "&Device"
             MenuItem {
                 text: "&Find"
-                enabled: !cd.connected
-                onClicked: disocvery.startDeviceDiscovery()
+                onClicked: findCameras()
+            }
+            MenuItem {
+                text: "&Simulated camera"
+                onClicked: cameras.connectSimulator()
             }
             MenuItem {
                 text: "&Disconnect"
@@ -229,6 +245,38 @@ ApplicationWindow {
                 onClicked: cd.disconnectFromDevice()
             }
         }
+        Menu {
+            id: cameraMenu
+            title: "&Cameras"
+            Instantiator {
+                model: cameras
+                delegate: MenuItem {
+                    text: model.name
+                    checkable: true
+                    checked: cameras.currentIndex==index
+                    onTriggered: cameras.currentIndex=index
+                }
+                onObjectAdded: (index, object) => cameraMenu.insertItem(index, object)
+                onObjectRemoved: (index, object) => cameraMenu.removeItem(object)
+            }
+            MenuSeparator {
+
+            }
+            MenuItem {
+                text: "&Record all"
+                enabled: cameras.count>0 && !cameras.recording
+                onClicked: cameras.record(true)
+            }
+            MenuItem {
+                text: "S&top all"
+                enabled: cameras.recording
+                onClicked: cameras.record(false)
+            }
+            MenuItem {
+                enabled: false
+                text: cameras.sync.samples>0 ? "Sync skew: "+cameras.sync.lastSkew.toFixed(1)+" ms (max "+cameras.sync.maxSkew.toFixed(1)+" ms)" : "Sync skew: -"
+            }
+        }
         Menu {
             title: "&Lens control"
             MenuItem {
@@ -278,6 +326,27 @@ ApplicationWindow {
                 checked: false
             }
         }
+        Menu {
+            title: "De&bug"
+            MenuItem {
+                text: "&Record trace"
+                checkable: true
+                checked: cd.tracing
+                enabled: cd.connected
+                onTriggered: checked ? cd.startTrace() : cd.stopTrace()
+            }
+            MenuItem {
+                text: "Re&play trace..."
+                onClicked: replayDialog.open()
+            }
+        }
+    }
+
+    FileDialog {
+        id: replayDialog
+        title: "Replay protocol trace"
+        nameFilters: [ "Protocol traces (*.cptrace)" ]
+        onAccepted: cameras.connectReplay(selectedFile)
     }
     
     ButtonGroup {
@@ -293,8 +362,7 @@ ApplicationWindow {
             ToolButton {
                 text: "Connect"
                 icon.name: "edit-find"
-                enabled: !cd.connected
-                onClicked: disocvery.startDeviceDiscovery()
+                onClicked: findCameras()
             }
             ToolButton {
                 text: "&Disconnect"
@@ -303,20 +371,20 @@ ApplicationWindow {
             }
             ToolButton {
                 text: "Play"
-                enabled: cd.connectionReady && !cd.recording && !cd.playing
+                enabled: connectionReady && !cd.recording && !cd.playing
                 onClicked: cd.play(true);
                 icon.name: "play"
             }
             /*
             ToolButton {
                 text: "CCR"
-                enabled: cd.connectionReady
+                enabled: connectionReady
                 onClicked: cd.colorCorrectionReset()
             }
             */
             ToolButton {
                 text: "Slate"
-                enabled: cd.connectionReady
+                enabled: connectionReady
                 onClicked: slateDrawer.open()
             }
         }
@@ -330,6 +398,11 @@ ApplicationWindow {
         onTriggered: timedMessage.text=''
     }
     
+    function findCameras() {
+        cameraDrawer.open()
+        disocvery.startDeviceDiscovery()
+    }
+
     function setTimedMessage(msg) {
         timedMessage.text=msg;
         timerMessageTimer.start()
@@ -358,32 +431,32 @@ ApplicationWindow {
             }
             Label {
                 id: zoom
-                text: cd.connectionReady ? cd.zoom : '--'
+                text: connectionReady ? cd.zoom : '--'
                 font.pixelSize: smallFontSize
             }
             Label {
-                text: cd.connectionReady ? cd.iso : '---'
+                text: connectionReady ? cd.iso : '---'
                 font.pixelSize: smallFontSize
             }
             Label {
-                text: cd.connectionReady ? '1/'+cd.shutterSpeed : '-/--'
+                text: connectionReady ? '1/'+cd.shutterSpeed : '-/--'
                 font.pixelSize: smallFontSize
             }
             Label {
                 id: aperture
-                text: cd.connectionReady ? 'f'+cd.aperture.toFixed(1) : '--'
+                text: connectionReady ? 'f'+cd.aperture.toFixed(1) : '--'
                 font.pixelSize: smallFontSize
             }
             Label {
-                text: cd.connectionReady ? cd.wb+"K" : '--'
+                text: connectionReady ? cd.wb+"K" : '--'
                 font.pixelSize: smallFontSize
             }
             Label {
-                text: cd.connectionReady ? cd.tint : '--'
+                text: connectionReady ? cd.tint : '--'
                 font.pixelSize: smallFontSize
             }
             Label {
-                text: cd.connectionReady ? 'Take: '+cd.metaTakeNumber : ''
+                text: connectionReady ? 'Take: '+cd.metaTakeNumber : ''
             }
             
             TimeCodeText {
@@ -403,8 +476,7 @@ ApplicationWindow {
         Keys.onPressed: {
             switch (event.key) {
             case Qt.Key_F2:
-                if (!cd.connected)
-                    disocvery.startDeviceDiscovery()
+                findCameras()
                 event.accepted=true;
                 break;
             }
@@ -413,7 +485,7 @@ ApplicationWindow {
             anchors.fill: parent
             anchors.margins: 4
             spacing: 4
-            enabled: cd.connectionReady
+            enabled: connectionReady
             RowLayout {
                 id: bc
                 Layout.fillWidth: true
@@ -454,7 +526,7 @@ ApplicationWindow {
                         Layout.fillHeight: true
                         text: "Capture"
                         icon.name: "camera-photo"
-                        enabled: cd.connectionReady && !cd.recording && !cd.playing
+                        enabled: connectionReady && !cd.recording && !cd.playing
                         onClicked: cd.captureStill()
                     }
                 }
@@ -677,7 +749,7 @@ ApplicationWindow {
                         Layout.fillWidth: true
                         from: -50
                         to: 50
-                        value: cd.connectionReady ? cd.tint : 0
+                        value: connectionReady ? cd.tint : 0
                         wheelEnabled: true
                         onValueModified: {
                             cd.whiteBalance(sliderWb.value, value)
@@ -691,7 +763,7 @@ ApplicationWindow {
                         id: sliderWb
                         from: 2500
                         to: 10000
-                        value: cd.connectionReady ? cd.wb : 4600
+                        value: connectionReady ? cd.wb : 4600
                         stepSize: 50
                         live: false
                         snapMode: Slider.SnapAlways
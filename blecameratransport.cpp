@@ -0,0 +1,534 @@
+#include "blecameratransport.h"
+#include "cameralogging.h"
+
+#include <QLowEnergyCharacteristic>
+#include <QSettings>
+
+// Services that BM camera should have
+static const QBluetoothUuid GenericService("00001800-0000-1000-8000-00805f9b34fb");
+static const QBluetoothUuid DeviceInformation("0000180a-0000-1000-8000-00805f9b34fb");
+static const QBluetoothUuid BmdCameraService("291D567A-6D75-11E6-8B77-86F30CA893D3");
+
+// Characteristics available
+static const QBluetoothUuid OutgoingCameraControl("5DD3465F-1AEE-4299-8493-D2ECA2F8E1BB");
+static const QBluetoothUuid IncomingCameraControl("B864E140-76A0-416A-BF30-5876504537D9");
+static const QBluetoothUuid Timecode("6D8F2110-86F1-41BF-9AFB-451D87E976C8");
+static const QBluetoothUuid CameraStatus("7FE8691D-95DC-4FC5-8ABD-CA74339B51B9");
+static const QBluetoothUuid DeviceName("FFAC0C52-C9FB-41A0-B063-CC76282EB89C");
+
+// ATT MTU before any exchange, a write carries the MTU less the 3 byte ATT header
+static const int DefaultMtu = 23;
+static const int AttHeaderSize = 3;
+
+// Active connection parameters, intervals and timeouts in ms
+static const double ActiveIntervalMin = 7.5;
+static const double ActiveIntervalMax = 15.0;
+static const int ActiveSupervisionTimeout = 2000;
+
+// Idle connection parameters, the camera may skip IdleLatency connection events
+static const double IdleIntervalMin = 100.0;
+static const double IdleIntervalMax = 200.0;
+static const int IdleLatency = 2;
+static const int IdleSupervisionTimeout = 4000;
+
+BleCameraTransport::BleCameraTransport(QObject *parent)
+    : CameraTransport{parent}
+{
+
+}
+
+BleCameraTransport::~BleCameraTransport()
+{
+    clearServices();
+    if (m_controller) {
+        m_controller->disconnectFromDevice();
+    }
+}
+
+void BleCameraTransport::clearServices()
+{
+    m_cameraService=nullptr;
+
+    delete m_cameraOutgoing;
+    m_cameraOutgoing=nullptr;
+
+    delete m_cameraName;
+    m_cameraName=nullptr;
+
+    m_pendingWrites.clear();
+
+    qDeleteAll(m_services);
+    m_services.clear();
+}
+
+void BleCameraTransport::connectToDevice(const QBluetoothDeviceInfo &device)
+{
+    qCDebug(lcGatt) << "Scanning for BM services for " << device.name();
+
+    if (m_controller) {
+        m_controller->disconnectFromDevice();
+        delete m_controller;
+        m_controller = nullptr;
+    }
+
+    clearServices();
+
+    m_device=device;
+    loadLayoutCache();
+
+    m_controller = QLowEnergyController::createCentral(m_device, this);
+
+    connect(m_controller, &QLowEnergyController::connected, this, &BleCameraTransport::deviceConnected);
+    connect(m_controller, &QLowEnergyController::errorOccurred, this, &BleCameraTransport::errorReceived);
+    connect(m_controller, &QLowEnergyController::disconnected, this, &BleCameraTransport::deviceDisconnected);
+    connect(m_controller, &QLowEnergyController::serviceDiscovered, this, &BleCameraTransport::addLowEnergyService);
+    connect(m_controller, &QLowEnergyController::discoveryFinished, this, &BleCameraTransport::serviceScanDone);
+    connect(m_controller, &QLowEnergyController::connectionUpdated, this, &BleCameraTransport::connectionUpdated);
+    connect(m_controller, &QLowEnergyController::mtuChanged, this, &BleCameraTransport::mtuChanged);
+
+    m_controller->setRemoteAddressType(QLowEnergyController::PublicAddress);
+
+    qCDebug(lcGatt) << "Connecting to " << device.name();
+    m_controller->connectToDevice();
+}
+
+void BleCameraTransport::addLowEnergyService(const QBluetoothUuid &serviceUuid)
+{
+    qCDebug(lcGatt) << "Service discovered" << serviceUuid;
+    QLowEnergyService *service = m_controller->createServiceObject(serviceUuid);
+    if (!service) {
+        qCWarning(lcGatt) << "Cannot create service for uuid";
+        return;
+    }
+
+    qCDebug(lcGatt) << "Service:" << service->serviceUuid() << service->state();
+
+    m_services.append(service);
+}
+
+void BleCameraTransport::serviceScanDone()
+{
+    qCDebug(lcGatt) << "Services discovered";
+    // xxx error
+    if (m_services.isEmpty()) {
+        qCDebug(lcGatt) << "No services found ?";
+        return;
+    }
+
+    qCDebug(lcGatt) << "Connecting to camera service" << BmdCameraService.toString();
+
+    connectToService(BmdCameraService);
+}
+
+void BleCameraTransport::connectToService(const QBluetoothUuid &uuid)
+{
+    QLowEnergyService *service = nullptr;
+    for (QLowEnergyService *s: std::as_const(m_services)) {
+        if (s->serviceUuid() == uuid) {
+            service = s;
+            break;
+        }
+    }
+
+    if (!service)
+        return;
+
+    if (service->state() == QLowEnergyService::RemoteService) {
+        connect(service, &QLowEnergyService::stateChanged, this, &BleCameraTransport::serviceDetailsDiscovered);
+        // Values of a known camera are restored from the cached state and updated by notifications
+        service->discoverDetails(m_cachedCharacteristics.isEmpty() ? QLowEnergyService::FullDiscovery : QLowEnergyService::SkipValueDiscovery);
+    } else if (service->state() == QLowEnergyService::RemoteServiceDiscovered) {
+        serviceDetailsDiscovered(QLowEnergyService::RemoteServiceDiscovered);
+    } else {
+        qCWarning(lcGatt) << "connectToService" << service->state();
+    }
+}
+
+void BleCameraTransport::deviceConnected()
+{
+    qCDebug(lcGatt) << "Connected, discovering services";
+
+    m_controller->discoverServices();
+    emit connected();
+}
+
+void BleCameraTransport::errorReceived(QLowEnergyController::Error error)
+{
+    emit errorChanged();
+
+    switch (error) {
+    case QLowEnergyController::RemoteHostClosedError:
+        deviceDisconnected();
+        break;
+    case QLowEnergyController::ConnectionError:
+        emit connectionFailure();
+        break;
+    default:
+        qCDebug(lcGatt) << "errorReceived" << error << m_controller->errorString();
+    }
+}
+
+void BleCameraTransport::disconnectFromDevice()
+{
+    if (!m_controller) {
+        deviceDisconnected();
+        return;
+    }
+
+    qCDebug(lcGatt) << "State is " << m_controller->state();
+
+    if (m_controller->state() != QLowEnergyController::UnconnectedState) {
+        qCDebug(lcGatt) << "Disconnecting from device";
+        m_controller->disconnectFromDevice();
+    } else {
+        qCDebug(lcGatt) << "Not connected ?";
+        deviceDisconnected();
+    }
+}
+
+void BleCameraTransport::deviceDisconnected()
+{
+    qCWarning(lcGatt) << "Disconnect from device";
+    if (m_cameraOutgoing) {
+        delete m_cameraOutgoing;
+        m_cameraOutgoing=nullptr;
+    }
+
+    emit disconnected();
+}
+
+void BleCameraTransport::serviceDetailsDiscovered(QLowEnergyService::ServiceState newState)
+{
+    qCDebug(lcGatt) << "serviceDetailsDiscovered" << newState;
+
+    auto service = qobject_cast<QLowEnergyService *>(sender());
+    if (!service) {
+        qCDebug(lcGatt) << "... invalid service?";
+        qCDebug(lcGatt) << "State is " << m_controller->state();
+        return;
+    }
+
+    if (service->state()==QLowEnergyService::RemoteServiceDiscovering) {
+        const QList<QLowEnergyCharacteristic> chars = service->characteristics();
+        qCDebug(lcGatt) << "Service: " << service->serviceName() << service->serviceUuid() << chars.size();
+
+        for (const QLowEnergyCharacteristic &ch : chars) {
+            qCDebug(lcGatt) << "QLowEnergyCharacteristic" << ch.uuid() << ch.value() << ch.value().size() << ch.value().toHex(':');
+        }
+        return;
+    }
+
+    if (service->state()==QLowEnergyService::InvalidService) {
+        qCDebug(lcGatt) << "Invalid service, disconnected from device ?";
+        qCDebug(lcGatt) << "State is " << m_controller->state();
+        return;
+    }
+
+    const QList<QLowEnergyCharacteristic> chars = service->characteristics();
+    qCDebug(lcGatt) << "Service: " << service->serviceName() << service->serviceUuid();
+
+    connect(service, &QLowEnergyService::stateChanged, this, &BleCameraTransport::serviceStateChanged);
+    connect(service, &QLowEnergyService::characteristicChanged, this, &BleCameraTransport::characteristicChanged);
+    connect(service, &QLowEnergyService::characteristicRead, this, &BleCameraTransport::characteristicChanged);
+    connect(service, &QLowEnergyService::descriptorWritten, this, &BleCameraTransport::confirmedDescriptorWrite);
+    connect(service, &QLowEnergyService::characteristicWritten, this, &BleCameraTransport::confirmedCharacteristicWrite);
+    connect(service, &QLowEnergyService::errorOccurred, this, &BleCameraTransport::serviceError);
+
+    m_cameraService=service;
+
+    for (const QLowEnergyCharacteristic &ch : chars) {
+        qCDebug(lcGatt) << "QLowEnergyCharacteristic" << ch.uuid() << ch.value() << ch.value().size() << ch.value().toHex(':');
+
+        QLowEnergyDescriptor desc = ch.descriptor(QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration);
+
+        if (ch.uuid()==OutgoingCameraControl) {
+            qCDebug(lcGatt) << "Found OutgoingCameraControl!";
+            m_cameraOutgoing=new QLowEnergyCharacteristic(ch);
+        } else if (ch.uuid()==DeviceName) {
+            qCDebug(lcGatt) << "Found DeviceName!";
+            m_cameraName=new QLowEnergyCharacteristic(ch);
+        } else if (ch.uuid()==CameraStatus) {
+            // XXX: Seems under Windows we get the value already here and it won't update later from a notification ?
+            if (!ch.value().isNull()) {
+                emit statusReceived(ch.value());
+            } else if (ch.properties() & QLowEnergyCharacteristic::Read) {
+                // Discovery with a cached layout skips the values, the status is not restored from the cache
+                service->readCharacteristic(ch);
+            }
+        } else if (ch.uuid()==IncomingCameraControl || ch.uuid()==Timecode) {
+            // Values read during discovery can carry state that is not sent again as a notification
+            if (!ch.value().isEmpty())
+                characteristicChanged(ch, ch.value());
+        } else {
+            qCDebug(lcGatt) << "Unhandled" << ch.uuid();
+        }
+
+        uint permission = ch.properties();
+        if ((permission & QLowEnergyCharacteristic::Notify)) {
+            qCDebug(lcGatt) << "Enabling notifications for " << ch.uuid() << ch.value().toHex(':');
+            service->writeDescriptor(desc, QLowEnergyCharacteristic::CCCDEnableNotification);
+        } else if (permission & QLowEnergyCharacteristic::Indicate) {
+            qCDebug(lcGatt) << "Enabling indications for " << ch.uuid() << ch.value().toHex(':');
+            service->writeDescriptor(desc, QLowEnergyCharacteristic::CCCDEnableIndication);
+        } else if (permission & QLowEnergyCharacteristic::Write) {
+            qCDebug(lcGatt) << "WriteCharacteristics" << ch.uuid();
+        }
+    }
+
+    saveLayoutCache(chars);
+
+    if (m_cameraOutgoing)
+        emit ready();
+}
+
+/**
+ * @brief BleCameraTransport::loadLayoutCache
+ *
+ * Load the camera service layout seen on a previous connection to the same camera.
+ * Qt has no way to inject cached attribute handles, discovery always runs, a known
+ * layout only lets it skip reading the characteristic values.
+ */
+void BleCameraTransport::loadLayoutCache()
+{
+    QSettings settings;
+
+    settings.beginGroup("gatt");
+    m_cachedCharacteristics=settings.value(address().remove(':')).toStringList();
+    settings.endGroup();
+}
+
+void BleCameraTransport::saveLayoutCache(const QList<QLowEnergyCharacteristic> &chars)
+{
+    QStringList uuids;
+    for (const QLowEnergyCharacteristic &ch : chars)
+        uuids.append(ch.uuid().toString());
+
+    uuids.sort();
+    if (uuids==m_cachedCharacteristics)
+        return;
+
+    QSettings settings;
+
+    settings.beginGroup("gatt");
+
+    if (m_cachedCharacteristics.isEmpty()) {
+        m_cachedCharacteristics=uuids;
+        settings.setValue(address().remove(':'), uuids);
+    } else {
+        // Values were skipped for a layout that no longer matches, do a full discovery next time
+        qCWarning(lcGatt) << "Camera service layout changed, cache invalidated" << m_cachedCharacteristics << uuids;
+        m_cachedCharacteristics.clear();
+        settings.remove(address().remove(':'));
+    }
+
+    settings.endGroup();
+}
+
+void BleCameraTransport::characteristicChanged(const QLowEnergyCharacteristic &characteristic, const QByteArray &value)
+{
+    qCPacket(lcRx) << "characteristicChanged" << characteristic.uuid() << value.toHex(':');
+    if (characteristic.uuid()==Timecode) {
+        emit timecodeReceived(value);
+    } else if (characteristic.uuid()==IncomingCameraControl) {
+        emit controlReceived(value);
+    } else if (characteristic.uuid()==CameraStatus) {
+        emit statusReceived(value);
+    }
+}
+
+void BleCameraTransport::serviceStateChanged(QLowEnergyService::ServiceState s)
+{
+    qCDebug(lcGatt) << "serviceStateChanged" << s;
+}
+
+void BleCameraTransport::confirmedDescriptorWrite(const QLowEnergyDescriptor &d, const QByteArray &value)
+{
+    qCDebug(lcGatt) << "confirmedDescriptorWrite" << d.name() << d.uuid() << value;
+}
+
+void BleCameraTransport::confirmedCharacteristicWrite(const QLowEnergyCharacteristic &c, const QByteArray &value)
+{
+    Q_UNUSED(value)
+
+    // Some backends also report unacknowledged writes, only acknowledged ones complete a write
+    if (!m_pendingWrites.removeOne(c.uuid()))
+        return;
+
+    if (c.uuid()==OutgoingCameraControl)
+        emit controlWritten();
+}
+
+/**
+ * @brief BleCameraTransport::serviceError
+ * @param error
+ *
+ * A write error does not tell the characteristic, writes are answered in order so it
+ * belongs to the oldest pending write. Only control write failures go to the command queue.
+ */
+void BleCameraTransport::serviceError(QLowEnergyService::ServiceError error)
+{
+    qCWarning(lcGatt) << "serviceError" << error;
+
+    if (error!=QLowEnergyService::CharacteristicWriteError || m_pendingWrites.isEmpty())
+        return;
+
+    const QBluetoothUuid uuid=m_pendingWrites.takeFirst();
+
+    if (uuid==OutgoingCameraControl)
+        emit controlWriteFailed();
+    else
+        qCWarning(lcGatt) << "Write failed" << uuid;
+}
+
+bool BleCameraTransport::isReady() const
+{
+    return m_controller && m_cameraService && m_cameraOutgoing;
+}
+
+bool BleCameraTransport::hasError() const
+{
+    return (m_controller && m_controller->error() != QLowEnergyController::NoError);
+}
+
+/**
+ * @brief BleCameraTransport::requestConnectionProfile
+ * @param profile
+ * @return true if the connection update was requested
+ *
+ * Not all platforms support connection updates from the central, the camera may also
+ * negotiate different values.
+ */
+bool BleCameraTransport::requestConnectionProfile(ConnectionProfile profile)
+{
+    if (!m_controller || m_controller->state()==QLowEnergyController::UnconnectedState)
+        return false;
+
+    QLowEnergyConnectionParameters p;
+
+    if (profile==ActiveConnection) {
+        p.setIntervalRange(ActiveIntervalMin, ActiveIntervalMax);
+        p.setLatency(0);
+        p.setSupervisionTimeout(ActiveSupervisionTimeout);
+    } else {
+        p.setIntervalRange(IdleIntervalMin, IdleIntervalMax);
+        p.setLatency(IdleLatency);
+        p.setSupervisionTimeout(IdleSupervisionTimeout);
+    }
+
+    qCDebug(lcGatt) << "Requesting connection update" << p.minimumInterval() << p.maximumInterval() << p.latency();
+
+    m_controller->requestConnectionUpdate(p);
+
+    return true;
+}
+
+void BleCameraTransport::connectionUpdated(const QLowEnergyConnectionParameters &parameters)
+{
+    // Minimum and maximum are both the negotiated interval
+    emit connectionParametersChanged(parameters.maximumInterval(), parameters.latency(), parameters.supervisionTimeout());
+}
+
+void BleCameraTransport::mtuChanged(int mtu)
+{
+    qCDebug(lcGatt) << "MTU" << mtu;
+
+    emit maximumWriteSizeChanged();
+}
+
+/**
+ * @brief BleCameraTransport::maximumWriteSize
+ * @return largest write that fits in one ATT packet at the negotiated MTU
+ */
+int BleCameraTransport::maximumWriteSize() const
+{
+    const int mtu=m_controller ? m_controller->mtu() : -1;
+
+    return (mtu>0 ? mtu : DefaultMtu)-AttHeaderSize;
+}
+
+bool BleCameraTransport::canWriteUnacknowledged() const
+{
+    return m_cameraOutgoing && (m_cameraOutgoing->properties() & QLowEnergyCharacteristic::WriteNoResponse);
+}
+
+QString BleCameraTransport::name() const
+{
+    return m_device.name();
+}
+
+QString BleCameraTransport::address() const
+{
+    return deviceAddress(m_device);
+}
+
+/**
+ * @brief BleCameraTransport::writeControl
+ * @param data
+ * @param mode
+ * @return true if the write was issued
+ *
+ * Unacknowledged writes use ATT write commands, no response round trip is needed so
+ * several can go out in one connection event. The caller only asks for one when
+ * canWriteUnacknowledged() and the data fits maximumWriteSize(), anything else is
+ * written acknowledged.
+ */
+bool BleCameraTransport::writeControl(const QByteArray &data, WriteMode mode)
+{
+    if (!m_controller) {
+        qCWarning(lcGatt, "No controller!");
+        return false;
+    }
+
+    if (!m_cameraService) {
+        qCWarning(lcGatt, "Camera service not available");
+        return false;
+    }
+
+    if (!m_cameraOutgoing) {
+        qCWarning(lcGatt, "Camera descriptor not available");
+        return false;
+    }
+
+    if (!m_cameraOutgoing->isValid())
+        qCWarning(lcGatt, "Camera descriptor is not valid ?");
+
+    // A write command can not be split, anything larger must go as an acknowledged long write
+    if (mode==UnacknowledgedWrite && canWriteUnacknowledged() && data.size()<=maximumWriteSize()) {
+        qCPacket(lcTx) << "cmd unacknowledged" << data.toHex(':');
+        m_cameraService->writeCharacteristic(*m_cameraOutgoing, data, QLowEnergyService::WriteWithoutResponse);
+        return true;
+    }
+
+    qCPacket(lcTx) << "cmd" << data.toHex(':');
+
+    m_pendingWrites.append(OutgoingCameraControl);
+    m_cameraService->writeCharacteristic(*m_cameraOutgoing, data);
+
+    return true;
+}
+
+bool BleCameraTransport::writeName(const QByteArray &name)
+{
+    if (!m_controller) {
+        qCWarning(lcGatt, "No controller!");
+        return false;
+    }
+
+    if (!m_cameraService) {
+        qCWarning(lcGatt, "Camera service not available");
+        return false;
+    }
+
+    if (!m_cameraName) {
+        qCWarning(lcGatt, "Camera name descriptor not available");
+        return false;
+    }
+
+    if (!m_cameraName->isValid())
+        qCWarning(lcGatt, "Camera name descriptor is not valid ?");
+
+    m_pendingWrites.append(DeviceName);
+    m_cameraService->writeCharacteristic(*m_cameraName, name);
+
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef BLECAMERATRANSPORT_H
+#define BLECAMERATRANSPORT_H
+
+#include "cameratransport.h"
+
+#include <QBluetoothDeviceInfo>
+#include <QLowEnergyController>
+#include <QLowEnergyConnectionParameters>
+#include <QBluetoothUuid>
+#include <QList>
+#include <QStringList>
+
+/**
+ * @brief The BleCameraTransport class
+ *
+ * Camera transport over the Blackmagic camera Bluetooth LE service.
+ */
+class BleCameraTransport : public CameraTransport
+{
+    Q_OBJECT
+public:
+    explicit BleCameraTransport(QObject *parent = nullptr);
+    ~BleCameraTransport();
+
+    void connectToDevice(const QBluetoothDeviceInfo &device) override;
+    void disconnectFromDevice() override;
+
+    bool isReady() const override;
+
+    bool writeControl(const QByteArray &data, WriteMode mode) override;
+    bool writeName(const QByteArray &name) override;
+
+    QString name() const override;
+    QString address() const override;
+
+    bool hasError() const override;
+
+    bool canWriteUnacknowledged() const override;
+
+    int maximumWriteSize() const override;
+
+    bool requestConnectionProfile(ConnectionProfile profile) override;
+
+private slots:
+    void addLowEnergyService(const QBluetoothUuid &uuid);
+    void deviceConnected();
+    void errorReceived(QLowEnergyController::Error);
+    void serviceScanDone();
+    void deviceDisconnected();
+    void connectionUpdated(const QLowEnergyConnectionParameters &parameters);
+    void mtuChanged(int mtu);
+
+    void serviceDetailsDiscovered(QLowEnergyService::ServiceState newState);
+
+    void characteristicChanged(const QLowEnergyCharacteristic &characteristic, const QByteArray &value);
+    void serviceStateChanged(QLowEnergyService::ServiceState s);
+    void confirmedDescriptorWrite(const QLowEnergyDescriptor &d, const QByteArray &value);
+    void confirmedCharacteristicWrite(const QLowEnergyCharacteristic &c, const QByteArray &value);
+    void serviceError(QLowEnergyService::ServiceError error);
+
+private:
+    void connectToService(const QBluetoothUuid &uuid);
+    void clearServices();
+
+    void loadLayoutCache();
+    void saveLayoutCache(const QList<QLowEnergyCharacteristic> &chars);
+
+    QBluetoothDeviceInfo m_device;
+
+    // Camera service characteristics seen on the previous connection
+    QStringList m_cachedCharacteristics;
+
+    QList<QLowEnergyService *> m_services;
+
+    QLowEnergyController *m_controller = nullptr;
+    QLowEnergyService *m_cameraService = nullptr;
+    QLowEnergyCharacteristic *m_cameraOutgoing = nullptr;
+    QLowEnergyCharacteristic *m_cameraName = nullptr;
+
+    // Characteristics of the acknowledged writes waiting for the write response, oldest first
+    QList<QBluetoothUuid> m_pendingWrites;
+};
+
+#endif // BLECAMERATRANSPORT_H
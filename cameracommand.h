@@ -0,0 +1,155 @@
+#ifndef CAMERACOMMAND_H
+#define CAMERACOMMAND_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <utility>
+
+#include "cameratypes.h"
+#include "camerawire.h"
+
+namespace CutePocket
+{
+
+// Largest write to the Outgoing Camera Control characteristic
+constexpr int MaxCommandSize = 64;
+
+enum Operation : quint8
+{
+    AssignOperation = 0x00,
+    OffsetOperation = 0x01,
+    // Not in the published protocol, seen in captured time display commands
+    DisplayOperation = 0x02
+};
+
+/**
+ * @brief The Command struct
+ *
+ * One outgoing camera control message with header, payload and padding,
+ * stored inline so building and queueing a command does not allocate.
+ */
+struct Command
+{
+    std::array<std::byte, MaxCommandSize> data {};
+    qsizetype size = 0;
+
+    constexpr quint8 at(qsizetype i) const { return std::to_integer<quint8>(data[i]); }
+
+    constexpr quint8 length() const { return at(1); }
+    constexpr quint8 category() const { return at(4); }
+    constexpr quint8 parameter() const { return at(5); }
+    constexpr quint8 type() const { return at(6); }
+    constexpr quint8 operation() const { return at(7); }
+
+    constexpr Wire::Bytes bytes() const { return Wire::Bytes(data).first(size); }
+    constexpr Wire::MutableBytes bytes() { return Wire::MutableBytes(data).first(size); }
+
+    QByteArrayView view() const { return QByteArrayView(reinterpret_cast<const char *>(data.data()), size); }
+    QByteArray toByteArray() const { return view().toByteArray(); }
+
+    constexpr bool isValid() const { return size>=MessageHeaderSize && size<=MaxCommandSize; }
+};
+
+template<DataType Type> struct DataTypeElement;
+template<> struct DataTypeElement<VoidType> { using type = void; };
+template<> struct DataTypeElement<Int8Type> { using type = qint8; };
+template<> struct DataTypeElement<Int16Type> { using type = qint16; };
+template<> struct DataTypeElement<Int32Type> { using type = qint32; };
+template<> struct DataTypeElement<Int64Type> { using type = qint64; };
+// Raw 5.11 fixed point
+template<> struct DataTypeElement<Fixed16Type> { using type = qint16; };
+// UTF-8 text, not terminated
+template<> struct DataTypeElement<StringType> { using type = char; };
+
+/**
+ * @brief The CommandBuilder struct
+ *
+ * Typed builder for one camera control parameter. The values must be of the
+ * element type of the parameter data type, length and padding are computed and
+ * the payload size is checked at compile time. Text is only known at run time,
+ * a string too long for one command gives an invalid command.
+ */
+template<quint8 Category, quint8 Parameter, DataType Type>
+struct CommandBuilder
+{
+    using Element = typename DataTypeElement<Type>::type;
+
+    static constexpr Command header(Operation op, std::size_t payload)
+    {
+        Command cmd;
+        cmd.data[0]=std::byte{0xff}; // Destination, all devices
+        cmd.data[1]=static_cast<std::byte>(4+payload); // Length of command header and payload
+        cmd.data[4]=std::byte{Category};
+        cmd.data[5]=std::byte{Parameter};
+        cmd.data[6]=static_cast<std::byte>(Type);
+        cmd.data[7]=static_cast<std::byte>(op);
+
+        // Padded to 4 bytes
+        cmd.size=(MessageHeaderSize+payload+3) & ~std::size_t(3);
+
+        return cmd;
+    }
+
+    template<std::same_as<Element>... Values>
+    static constexpr Command build(Operation op, Values... values)
+    {
+        constexpr std::size_t payload=sizeof...(Values)*dataTypeSize(Type);
+
+        static_assert(Type==VoidType || sizeof...(Values)>0, "Parameter needs a value");
+        static_assert(MessageHeaderSize+payload<=MaxCommandSize, "Command too large");
+
+        Command cmd=header(op, payload);
+
+        if constexpr (sizeof...(Values)>0) {
+            std::size_t p=MessageHeaderSize;
+            (Wire::store<Element>(cmd.data, std::exchange(p, p+sizeof(Element)), values), ...);
+        }
+
+        return cmd;
+    }
+
+    template<std::same_as<Element>... Values>
+    static constexpr Command assign(Values... values) { return build(AssignOperation, values...); }
+
+    template<std::same_as<Element>... Values>
+    static constexpr Command offset(Values... values) { return build(OffsetOperation, values...); }
+
+    static constexpr Command trigger() requires (Type==VoidType) { return build(AssignOperation); }
+
+    static constexpr Command assign(QByteArrayView text) requires (Type==StringType)
+    {
+        if (MessageHeaderSize+text.size()>MaxCommandSize)
+            return Command();
+
+        Command cmd=header(AssignOperation, text.size());
+
+        for (qsizetype i=0; i<text.size(); i++)
+            cmd.data[MessageHeaderSize+i]=static_cast<std::byte>(text.at(i));
+
+        return cmd;
+    }
+};
+
+namespace Check
+{
+constexpr Command Record=CommandBuilder<10, 1, Int8Type>::assign(qint8(2));
+static_assert(Record.size==12 && Record.length()==5 && Record.type()==Int8Type && Record.at(8)==2);
+
+constexpr Command WhiteBalance=CommandBuilder<1, 2, Int16Type>::assign(qint16(5600), qint16(-10));
+static_assert(WhiteBalance.size==12 && WhiteBalance.length()==8);
+static_assert(Wire::load<qint16>(WhiteBalance.bytes(), 8)==5600 && Wire::load<qint16>(WhiteBalance.bytes(), 10)==-10);
+
+constexpr Command Lift=CommandBuilder<8, 0, Fixed16Type>::offset(qint16(1), qint16(2), qint16(3), qint16(-4));
+static_assert(Lift.size==16 && Lift.length()==12 && Lift.operation()==OffsetOperation && Lift.at(15)==0xff);
+
+constexpr Command AutoFocus=CommandBuilder<0, 1, VoidType>::trigger();
+static_assert(AutoFocus.size==8 && AutoFocus.length()==4 && AutoFocus.category()==0 && AutoFocus.parameter()==1);
+}
+
+}
+
+#endif // CAMERACOMMAND_H
@@ -0,0 +1,346 @@
+#include "cameracommandqueue.h"
+#include "cameralogging.h"
+
+#include <QDebug>
+
+// Release the next command even if the write acknowledgement never arrives
+static const int WriteTimeout = 500;
+
+// Unacknowledged writes allowed back to back, kept below typical controller buffer counts
+static const int MaxCredits = 4;
+
+// One credit back per interval, about one connection event
+static const int CreditInterval = 15;
+
+
+CameraCommandQueue::CameraCommandQueue(QObject *parent)
+    : QObject{parent}
+    , m_credits(MaxCredits)
+{
+    m_watchdog.setSingleShot(true);
+    m_watchdog.setInterval(WriteTimeout);
+
+    m_creditTimer.setInterval(CreditInterval);
+    connect(&m_creditTimer, &QTimer::timeout, this, &CameraCommandQueue::refillCredit);
+
+    connect(&m_watchdog, &QTimer::timeout, this, [this]() {
+        // The response still counts against the write when it arrives late
+        qCWarning(lcTx, "Command write not acknowledged, continuing");
+        finishWrite(false);
+    });
+}
+
+/**
+ * @brief CameraCommandQueue::commandKey
+ * @param cmd
+ * @return Coalescing key, category, parameter and operation
+ */
+quint32 CameraCommandQueue::commandKey(const CutePocket::Command &cmd)
+{
+    return (cmd.category() << 16) | (cmd.parameter() << 8) | cmd.operation();
+}
+
+/**
+ * @brief CameraCommandQueue::isRelative
+ * @param cmd
+ * @return true if the command is an offset operation on 16-bit values that can be summed
+ */
+bool CameraCommandQueue::isRelative(const CutePocket::Command &cmd)
+{
+    const quint8 type=cmd.type();
+
+    return cmd.operation()==CutePocket::OffsetOperation && (type==CutePocket::Int16Type || type==CutePocket::Fixed16Type);
+}
+
+/**
+ * @brief CameraCommandQueue::mergeRelative
+ * @param pending
+ * @param cmd
+ *
+ * Add the offsets of cmd to the pending command, saturated to 16-bits.
+ */
+void CameraCommandQueue::mergeRelative(CutePocket::Command &pending, const CutePocket::Command &cmd)
+{
+    namespace Wire = CutePocket::Wire;
+
+    const int len=qMin(pending.length(), cmd.length())+4;
+
+    for (int p=CutePocket::MessageHeaderSize; p+1<len; p+=2) {
+        const qint32 a=Wire::load<qint16>(pending.bytes(), p);
+        const qint32 b=Wire::load<qint16>(cmd.bytes(), p);
+
+        Wire::store<qint16>(pending.bytes(), p, qBound(-32768, a+b, 32767));
+    }
+}
+
+/**
+ * @brief CameraCommandQueue::enqueue
+ * @param cmd
+ * @param mode
+ * @return
+ *
+ * Queue a command, replacing any pending command with the same key. An assignment also drops
+ * a pending offset to the same parameter, it would otherwise be sent after the new value.
+ * If nothing is in flight the command is released immediately.
+ */
+bool CameraCommandQueue::enqueue(const CutePocket::Command &cmd, CameraTransport::WriteMode mode)
+{
+    if (!cmd.isValid())
+        return false;
+
+    const quint32 key=commandKey(cmd);
+
+    // An absolute value supersedes offsets still waiting for the same parameter
+    if (cmd.operation()==CutePocket::AssignOperation)
+        remove((key & ~0xffu) | CutePocket::OffsetOperation);
+
+    const auto pending=m_pending.find(key);
+
+    if (pending!=m_pending.end()) {
+        if (isRelative(cmd))
+            mergeRelative(*pending, cmd);
+        else
+            *pending=cmd;
+    } else {
+        m_order.append(key);
+        m_pending.insert(key, cmd);
+    }
+
+    // Write commands can not be split, a command larger than a packet must be acknowledged
+    if (mode==CameraTransport::UnacknowledgedWrite && cmd.size<=m_packetSize)
+        m_unacknowledged.insert(key);
+    else
+        m_unacknowledged.remove(key);
+
+    if (!m_inFlight && m_hold==0)
+        release();
+
+    return true;
+}
+
+void CameraCommandQueue::remove(quint32 key)
+{
+    if (m_pending.remove(key)) {
+        m_order.removeOne(key);
+        m_unacknowledged.remove(key);
+    }
+}
+
+void CameraCommandQueue::clear()
+{
+    m_generation++;
+    m_watchdog.stop();
+    m_creditTimer.stop();
+    m_order.clear();
+    m_pending.clear();
+    m_unacknowledged.clear();
+    m_inFlight=false;
+    m_written=0;
+    m_answered=0;
+    m_hold=0;
+    m_credits=MaxCredits;
+}
+
+/**
+ * @brief CameraCommandQueue::hold
+ *
+ * Collect commands without releasing them until a matching resume(), so that
+ * they are packed into as few writes as possible.
+ */
+void CameraCommandQueue::hold()
+{
+    m_hold++;
+}
+
+void CameraCommandQueue::resume()
+{
+    if (m_hold==0)
+        return;
+
+    m_hold--;
+
+    if (m_hold==0 && !m_inFlight)
+        release();
+}
+
+/**
+ * @brief CameraCommandQueue::setMaximumPacketSize
+ * @param size largest write the link sends as one packet
+ *
+ * Packed writes are filled up to this size. A single command larger than this is still
+ * written, alone and acknowledged, so the stack can use a long write for it.
+ */
+void CameraCommandQueue::setMaximumPacketSize(int size)
+{
+    size=qBound(CutePocket::MessageHeaderSize, size & ~3, CutePocket::MaxCommandSize);
+
+    if (m_packetSize==size)
+        return;
+
+    m_packetSize=size;
+
+    for (auto i=m_unacknowledged.begin(); i!=m_unacknowledged.end();) {
+        if (m_pending.value(*i).size>m_packetSize)
+            i=m_unacknowledged.erase(i);
+        else
+            ++i;
+    }
+}
+
+bool CameraCommandQueue::busy() const
+{
+    return m_inFlight;
+}
+
+qsizetype CameraCommandQueue::pending() const
+{
+    return m_order.size();
+}
+
+/**
+ * @brief CameraCommandQueue::writeStarted
+ *
+ * An acknowledged write goes out, wait for its response before releasing more. Also called
+ * for a packet released as unacknowledged that is sent as an acknowledged write after all.
+ */
+void CameraCommandQueue::writeStarted()
+{
+    m_written++;
+    m_inFlight=true;
+    m_watchdog.start();
+}
+
+/**
+ * @brief CameraCommandQueue::writeCompleted
+ *
+ * An acknowledged write was answered. Responses come in write order, only the response
+ * to the latest write releases the next pending command, a late one for a write the
+ * watchdog already gave up on is ignored.
+ */
+void CameraCommandQueue::writeCompleted()
+{
+    if (m_answered==m_written) {
+        qCWarning(lcTx, "Unexpected command write response");
+        return;
+    }
+
+    if (++m_answered<m_written)
+        return;
+
+    finishWrite(true);
+}
+
+/**
+ * @brief CameraCommandQueue::finishWrite
+ * @param acknowledged the write was answered, not timed out
+ */
+void CameraCommandQueue::finishWrite(bool acknowledged)
+{
+    m_watchdog.stop();
+    m_inFlight=false;
+
+    // Acknowledged writes are answered in order, everything before has been sent
+    if (acknowledged) {
+        m_credits=MaxCredits;
+        m_creditTimer.stop();
+    }
+
+    if (m_hold==0)
+        release();
+    else
+        emit drained();
+}
+
+/**
+ * @brief CameraCommandQueue::writeFailed
+ *
+ * The transport may report the failure from inside write(), continue from the event loop
+ * instead of releasing the next command recursively.
+ */
+void CameraCommandQueue::writeFailed()
+{
+    qCWarning(lcTx, "Command write failed");
+
+    m_watchdog.stop();
+
+    QMetaObject::invokeMethod(this, [this, generation=m_generation]() {
+        // Skip if the queue was cleared meanwhile, a new write may already be in flight
+        if (generation==m_generation)
+            writeCompleted();
+    }, Qt::QueuedConnection);
+}
+
+void CameraCommandQueue::refillCredit()
+{
+    m_credits++;
+
+    if (m_credits>=MaxCredits)
+        m_creditTimer.stop();
+
+    if (m_hold==0 && !m_inFlight)
+        release();
+}
+
+/**
+ * @brief CameraCommandQueue::takePacket
+ * @param unacknowledged
+ * @return pending commands of the same write mode, in queued order, concatenated into one packet of at most the maximum packet size
+ *
+ * Every command is already padded to 4 bytes so the packet stays aligned.
+ */
+QByteArray CameraCommandQueue::takePacket(bool unacknowledged)
+{
+    QByteArray packet;
+    packet.reserve(CutePocket::MaxCommandSize);
+
+    while (!m_order.isEmpty()) {
+        const quint32 key=m_order.first();
+        const CutePocket::Command &cmd=m_pending[key];
+
+        if (m_unacknowledged.contains(key)!=unacknowledged)
+            break;
+
+        if (!packet.isEmpty() && packet.size()+cmd.size>m_packetSize)
+            break;
+
+        packet.append(cmd.view());
+        m_pending.remove(key);
+        m_unacknowledged.remove(key);
+        m_order.removeFirst();
+    }
+
+    return packet;
+}
+
+/**
+ * @brief CameraCommandQueue::release
+ *
+ * Write pending commands. An acknowledged write blocks the queue until it completes,
+ * unacknowledged writes go out back to back while there are credits left.
+ */
+void CameraCommandQueue::release()
+{
+    while (!m_order.isEmpty() && !m_inFlight) {
+        const bool unacknowledged=m_unacknowledged.contains(m_order.first());
+
+        if (!unacknowledged) {
+            const QByteArray packet=takePacket(false);
+
+            writeStarted();
+
+            emit write(packet, CameraTransport::AcknowledgedWrite);
+            continue;
+        }
+
+        if (m_credits==0) {
+            // Released again when a credit is back
+            return;
+        }
+
+        m_credits--;
+        if (!m_creditTimer.isActive())
+            m_creditTimer.start();
+
+        emit write(takePacket(true), CameraTransport::UnacknowledgedWrite);
+    }
+}
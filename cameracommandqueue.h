@@ -0,0 +1,86 @@
+#ifndef CAMERACOMMANDQUEUE_H
+#define CAMERACOMMANDQUEUE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QTimer>
+
+#include "cameracommand.h"
+#include "cameratransport.h"
+
+/**
+ * @brief The CameraCommandQueue class
+ *
+ * Outgoing command scheduler for one camera connection. Only the latest
+ * command for each category/parameter/operation is kept, relative (offset)
+ * commands are summed and only one write is in flight at a time. Pending
+ * commands are packed together into writes of up to the transport write size,
+ * at most 64 bytes.
+ *
+ * Commands queued as unacknowledged writes do not wait for a write response,
+ * they are paced with credits instead: each write uses a credit, credits refill
+ * at a fixed rate and all at once when an acknowledged write completes, as that
+ * means every earlier write has left the controller.
+ */
+class CameraCommandQueue : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CameraCommandQueue(QObject *parent = nullptr);
+
+    bool enqueue(const CutePocket::Command &cmd, CameraTransport::WriteMode mode=CameraTransport::AcknowledgedWrite);
+    void clear();
+
+    void hold();
+    void resume();
+
+    bool busy() const;
+    qsizetype pending() const;
+
+    int maximumPacketSize() const { return m_packetSize; }
+    void setMaximumPacketSize(int size);
+
+    void writeStarted();
+
+public slots:
+    void writeCompleted();
+    void writeFailed();
+
+signals:
+    void write(const QByteArray &cmd, CameraTransport::WriteMode mode);
+
+    // Write completed while the queue is held, the next release goes out immediately
+    void drained();
+
+private slots:
+    void refillCredit();
+
+private:
+    void release();
+    void finishWrite(bool acknowledged);
+    void remove(quint32 key);
+    QByteArray takePacket(bool unacknowledged);
+
+    static quint32 commandKey(const CutePocket::Command &cmd);
+    static bool isRelative(const CutePocket::Command &cmd);
+    static void mergeRelative(CutePocket::Command &pending, const CutePocket::Command &cmd);
+
+    QList<quint32> m_order;
+    QHash<quint32, CutePocket::Command> m_pending;
+    QSet<quint32> m_unacknowledged;
+    bool m_inFlight=false;
+    int m_hold=0;
+    int m_credits;
+    quint32 m_generation=0;
+    // Acknowledged writes issued and answered, answers come in the same order
+    quint64 m_written=0;
+    quint64 m_answered=0;
+    int m_packetSize=CutePocket::MaxCommandSize;
+    QTimer m_watchdog;
+    QTimer m_creditTimer;
+};
+
+#endif // CAMERACOMMANDQUEUE_H
@@ -0,0 +1,140 @@
+#ifndef CAMERADECODER_H
+#define CAMERADECODER_H
+
+#include <QByteArrayView>
+#include <QDebug>
+
+#include <cstddef>
+
+#include "cameratypes.h"
+#include "cameralogging.h"
+
+namespace CutePocket
+{
+
+/**
+ * @brief The ParameterDescriptor struct
+ *
+ * Describes one incoming camera control parameter: expected data type,
+ * minimum element count and the handler that stores it, nullptr handler
+ * parameters are only logged. Messages of another data type are rejected.
+ */
+template<class T>
+struct ParameterDescriptor
+{
+    quint8 category;
+    quint8 parameter;
+    quint8 type;
+    quint8 count;
+    const char *name;
+    void (T::*handler)(const Message &msg);
+};
+
+constexpr int MaxCategories = 16;
+constexpr int MaxParameters = 32;
+
+/**
+ * @brief The ControlDecoder class
+ *
+ * Decodes incoming camera control packets using a descriptor table. The
+ * category/parameter lookup index is built at compile time.
+ */
+template<class T, std::size_t N>
+class ControlDecoder
+{
+public:
+    constexpr ControlDecoder(const ParameterDescriptor<T> (&table)[N])
+        : m_table(table), m_index()
+    {
+        for (int c=0; c<MaxCategories; c++)
+            for (int p=0; p<MaxParameters; p++)
+                m_index[c][p]=-1;
+
+        for (std::size_t i=0; i<N; i++)
+            m_index[table[i].category][table[i].parameter]=i;
+    }
+
+    constexpr const ParameterDescriptor<T> *find(quint8 category, quint8 parameter) const
+    {
+        if (category>=MaxCategories || parameter>=MaxParameters)
+            return nullptr;
+
+        const int i=m_index[category][parameter];
+
+        return i<0 ? nullptr : &m_table[i];
+    }
+
+    /**
+     * @brief decode
+     * @param target
+     * @param data
+     * @param counters message and error counters of the connection
+     * @return number of messages decoded
+     *
+     * Walk all messages in the packet, every message is bounds checked against its
+     * length field and the descriptor before the handler is called.
+     */
+    int decode(T *target, QByteArrayView data, PacketCounters &counters) const
+    {
+        int messages=0;
+        const Messages packet(data);
+
+        for (const Message &msg : packet) {
+            if (msg.destination!=255)
+                continue;
+
+            dispatch(target, msg, counters);
+            messages++;
+        }
+
+        count(counters.rxMessages, messages);
+
+        if (packet.truncated()) {
+            count(counters.rxErrors);
+            qCWarning(lcRx) << "Truncated camera control message" << data.toByteArray().toHex(':');
+        }
+
+        return messages;
+    }
+
+private:
+    void dispatch(T *target, const Message &msg, PacketCounters &counters) const
+    {
+        const ParameterDescriptor<T> *d=find(msg.category, msg.parameter);
+
+        if (!d) {
+            qCPacket(lcRx) << "Unknown camera control" << msg.category << msg.parameter << msg.payload.toByteArray().toHex(':');
+            return;
+        }
+
+        // Handlers read the payload as the descriptor type, anything else would decode as garbage or 0
+        if (msg.type!=d->type) {
+            if (!d->handler) {
+                qCPacket(lcRx) << "Unexpected data type" << d->name << msg.type;
+                return;
+            }
+
+            count(counters.rxErrors);
+            qCWarning(lcRx) << "Unexpected data type" << d->name << msg.type << "expected" << d->type;
+            return;
+        }
+
+        if (msg.payload.size() < d->count*dataTypeSize(d->type)) {
+            count(counters.rxErrors);
+            qCWarning(lcRx) << "Short camera control message" << d->name << msg.payload.toByteArray().toHex(':');
+            return;
+        }
+
+        if (d->handler)
+            (target->*(d->handler))(msg);
+        else
+            qCPacket(lcRx) << d->name << msg.payload.toByteArray().toHex(':');
+    }
+
+    const ParameterDescriptor<T> *m_table;
+    int m_index[MaxCategories][MaxParameters];
+};
+
+}
+
+#endif // CAMERADECODER_H
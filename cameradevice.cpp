@@ -1,203 +1,537 @@
 #include "cameradevice.h"
 #include "cameratypes.h"
+#include "camerawire.h"
+#include "cameracommand.h"
+#include "fixedpoint.h"
+#include "cameradecoder.h"
+#include "cameracommandqueue.h"
+#include "blecameratransport.h"
+#include "simulatedcameratransport.h"
+#include "replaycameratransport.h"
+#include "cameratrace.h"
+#include "cameralogging.h"
+
+#include <QDir>
+#include <QStandardPaths>
+
+#include <iterator>
+#include <type_traits>
+
+namespace Wire = CutePocket::Wire;
+
+using CutePocket::CommandBuilder;
+using CutePocket::VoidType;
+using CutePocket::Int8Type;
+using CutePocket::Int16Type;
+using CutePocket::Int32Type;
+using CutePocket::Fixed16Type;
+using CutePocket::DisplayOperation;
+
+// Outgoing camera control parameters
+using FocusCommand = CommandBuilder<0, 0, Fixed16Type>;
+using AutoFocusCommand = CommandBuilder<0, 1, VoidType>;
+using ApertureCommand = CommandBuilder<0, 2, Fixed16Type>;
+using ApertureNormalizedCommand = CommandBuilder<0, 3, Fixed16Type>;
+using ApertureOrdinalCommand = CommandBuilder<0, 4, Int16Type>;
+using AutoApertureCommand = CommandBuilder<0, 5, VoidType>;
+using ZoomNormalizedCommand = CommandBuilder<0, 8, Fixed16Type>;
+using WhiteBalanceCommand = CommandBuilder<1, 2, Int16Type>;
+using AutoWhiteBalanceCommand = CommandBuilder<1, 3, VoidType>;
+using RestoreAutoWhiteBalanceCommand = CommandBuilder<1, 4, VoidType>;
+using ShutterSpeedCommand = CommandBuilder<1, 12, Int32Type>;
+using GainCommand = CommandBuilder<1, 13, Int8Type>;
+using ISOCommand = CommandBuilder<1, 14, Int32Type>;
+using ColorBarsCommand = CommandBuilder<4, 4, Int8Type>;
+using TimecodeDisplayCommand = CommandBuilder<4, 7, Int8Type>;
+template<quint8 Parameter>
+using ColorCorrectionCommand = CommandBuilder<8, Parameter, Fixed16Type>;
+using ContrastCommand = CommandBuilder<8, 4, Fixed16Type>;
+using LumaMixCommand = CommandBuilder<8, 5, Fixed16Type>;
+using ColorAdjustCommand = CommandBuilder<8, 6, Fixed16Type>;
+using ColorCorrectionResetCommand = CommandBuilder<8, 7, VoidType>;
+using TransportModeCommand = CommandBuilder<10, 1, Int8Type>;
+using CaptureCommand = CommandBuilder<10, 3, VoidType>;
+
+// Reconnect backoff, doubled on every attempt up to the maximum
+static const int ReconnectDelay = 100;
+static const int ReconnectDelayMax = 3200;
+static const int ReconnectAttempts = 10;
+
+// Give up on a reconnect attempt that does not get camera control ready in time
+static const int ConnectTimeout = 3000;
 
-#include <QLowEnergyCharacteristic>
+/**
+ * @brief isContinuous
+ * @param cmd
+ * @return true for high rate continuous controls that may be sent without write acknowledgement
+ *
+ * Anything else, record and transport in particular, always waits for the write response.
+ */
+static bool isContinuous(const CutePocket::Command &cmd)
+{
+    switch (cmd.category()) {
+    case 0: // Lens: focus, zoom
+        return cmd.parameter()==0 || cmd.parameter()==7 || cmd.parameter()==8 || cmd.parameter()==9;
+    case 8: // Color correction
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief replaySlot
+ * @param cmd
+ * @return replay slot of the exposure, white balance or lens setting cmd changes, -1 if it is not restored after a reconnect
+ *
+ * Aperture as f-stop and as normalized value share one slot, only the last commanded form is replayed.
+ */
+static int replaySlot(const CutePocket::Command &cmd)
+{
+    const quint8 category=cmd.category();
+    const quint8 parameter=cmd.parameter();
+
+    switch (category) {
+    case 0: // Lens: focus, zoom, aperture as f-stop or normalized
+        if (parameter==0 || parameter==8)
+            return parameter;
+        return parameter==2 || parameter==3 ? 2 : -1;
+    case 1: // Video: WB, shutter speed, gain, ISO
+        return parameter==2 || parameter==12 || parameter==13 || parameter==14 ? (category << 8) | parameter : -1;
+    default:
+        return -1;
+    }
+}
+
+CameraDevice::CameraDevice()
+{
+    m_timecode=new TimecodeModel(this);
+    m_colorCorrection=new ColorCorrection(this);
+    m_latency=new LatencyStats(this);
+
+    m_connectionPolicy=new ConnectionPolicy(this);
+    connect(m_connectionPolicy, &ConnectionPolicy::profileRequested, this, [this](CameraTransport::ConnectionProfile profile) {
+        if (m_transport)
+            m_transport->requestConnectionProfile(profile);
+    });
+
+    m_queue=new CameraCommandQueue(this);
+    connect(m_queue, &CameraCommandQueue::write, this, &CameraDevice::sendCameraCommand);
+    connect(m_queue, &CameraCommandQueue::drained, this, &CameraDevice::writeIdle);
+
+    m_reconnectTimer.setSingleShot(true);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &CameraDevice::reconnect);
+
+    m_connectTimer.setSingleShot(true);
+    m_connectTimer.setInterval(ConnectTimeout);
+    connect(&m_connectTimer, &QTimer::timeout, this, [this]() {
+        qCWarning(lcGatt, "Reconnect timed out");
 
-// Services that BM camera should have
-static const QBluetoothUuid GenericService("00001800-0000-1000-8000-00805f9b34fb");
-static const QBluetoothUuid DeviceInformation("0000180a-0000-1000-8000-00805f9b34fb");
-static const QBluetoothUuid BmdCameraService("291D567A-6D75-11E6-8B77-86F30CA893D3");
+        // Connected but the control service never became ready, drop the link first
+        if (m_connected && m_transport)
+            m_transport->disconnectFromDevice();
 
-// Characteristics available
-static const QBluetoothUuid OutgoingCameraControl("5DD3465F-1AEE-4299-8493-D2ECA2F8E1BB");
-static const QBluetoothUuid IncomingCameraControl("B864E140-76A0-416A-BF30-5876504537D9");
-static const QBluetoothUuid Timecode("6D8F2110-86F1-41BF-9AFB-451D87E976C8");
-static const QBluetoothUuid CameraStatus("7FE8691D-95DC-4FC5-8ABD-CA74339B51B9");
-static const QBluetoothUuid DeviceName("FFAC0C52-C9FB-41A0-B063-CC76282EB89C");
+        scheduleReconnect();
+    });
+}
 
-static qint16 mapf(double x, double in_min, double in_max, double out_min, double out_max)
+CameraDevice::~CameraDevice()
 {
-    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+    if (m_transport) {
+        m_transport->disconnect(this);
+        m_transport->disconnectFromDevice();
+    }
 }
 
-static int16_t float2fix(double n)
+/**
+ * @brief CameraDevice::setTransport
+ * @param transport
+ *
+ * Replace the camera link, CameraDevice takes ownership of the transport.
+ */
+void CameraDevice::setTransport(CameraTransport *transport)
 {
-    unsigned short int int_part = 0, frac_part = 0;
-    int i;
-    double t;
+    if (m_transport==transport)
+        return;
 
-    int_part = (n > 0) ? (((int)floor(n)) << 11) : (((int)ceil(n)) << 11);
-    n = fabs(n) - floor(fabs(n));
+    m_userDisconnect=true;
 
-    t = 0.5;
-    for (i = 0; i < 11; i++) {
-        if ((n - t) >= 0) {
-            n -= t;
-            frac_part += (1 << (11 - 1 - i));
-        }
-        t = t /2;
+    if (m_transport) {
+        m_transport->disconnect(this);
+        m_transport->disconnectFromDevice();
+        m_transport->deleteLater();
     }
 
-    return int_part + frac_part;
+    if (m_connected)
+        deviceDisconnected();
+
+    m_queue->clear();
+
+    m_transport=transport;
+    if (!m_transport)
+        return;
+
+    m_transport->setParent(this);
+
+    connect(m_transport, &CameraTransport::connected, this, &CameraDevice::deviceConnected);
+    connect(m_transport, &CameraTransport::ready, this, &CameraDevice::deviceReady);
+    connect(m_transport, &CameraTransport::disconnected, this, &CameraDevice::deviceDisconnected);
+    connect(m_transport, &CameraTransport::connectionFailure, this, &CameraDevice::deviceConnectionFailure);
+    connect(m_transport, &CameraTransport::errorChanged, this, &CameraDevice::controllerErrorChanged);
+    connect(m_transport, &CameraTransport::controlReceived, this, &CameraDevice::handleControlData);
+    connect(m_transport, &CameraTransport::timecodeReceived, this, &CameraDevice::handleTimecodeData);
+    connect(m_transport, &CameraTransport::statusReceived, this, &CameraDevice::handleCameraStatus);
+    connect(m_transport, &CameraTransport::controlWritten, m_queue, &CameraCommandQueue::writeCompleted);
+    connect(m_transport, &CameraTransport::controlWriteFailed, m_queue, &CameraCommandQueue::writeFailed);
+    connect(m_transport, &CameraTransport::controlWritten, m_latency, &LatencyStats::writeCompleted);
+    connect(m_transport, &CameraTransport::controlWriteFailed, m_latency, &LatencyStats::writeFailed);
+    connect(m_transport, &CameraTransport::connectionParametersChanged, m_connectionPolicy, &ConnectionPolicy::parametersUpdated);
+    connect(m_transport, &CameraTransport::maximumWriteSizeChanged, this, &CameraDevice::updateWriteSize);
+}
+
+void CameraDevice::connectDevice(const QBluetoothDeviceInfo &device)
+{
+    if (!device.isValid())
+        return;
+
+    if (!qobject_cast<BleCameraTransport *>(m_transport))
+        setTransport(new BleCameraTransport());
+
+    m_device=device;
+    m_userDisconnect=false;
+    m_reconnectAttempts=0;
+    m_replay.clear();
+    setConnectionState(Connecting);
+
+    m_transport->connectToDevice(m_device);
 }
 
-CameraDevice::CameraDevice()
+/**
+ * @brief CameraDevice::connectSimulator
+ *
+ * Connect to an in-process simulated camera, for testing without hardware.
+ */
+void CameraDevice::connectSimulator()
 {
-    m_timecode.setHMS(0,0,0,0);
+    if (!qobject_cast<SimulatedCameraTransport *>(m_transport))
+        setTransport(new SimulatedCameraTransport());
+
+    m_device=QBluetoothDeviceInfo();
+    m_userDisconnect=false;
+    m_reconnectAttempts=0;
+    m_replay.clear();
+    setConnectionState(Connecting);
+
+    m_transport->connectToDevice(m_device);
 }
 
-CameraDevice::~CameraDevice()
-{    
-    qDeleteAll(m_services);
-    m_services.clear();
-    if (m_controller) {
-        m_controller->disconnectFromDevice();
+/**
+ * @brief CameraDevice::connectReplay
+ * @param file protocol trace recorded with startTrace()
+ * @param speed playback speed multiplier, 0 for as fast as possible
+ *
+ * Play back the camera side of a recorded session, for reproducing problems without hardware.
+ */
+void CameraDevice::connectReplay(const QString &file, double speed)
+{
+    ReplayCameraTransport *replay=new ReplayCameraTransport();
+    replay->setFile(file);
+    replay->setSpeed(speed);
+    setTransport(replay);
+
+    m_device=QBluetoothDeviceInfo();
+    m_userDisconnect=false;
+    m_reconnectAttempts=0;
+    m_replay.clear();
+    setConnectionState(Connecting);
+
+    m_transport->connectToDevice(m_device);
+}
+
+/**
+ * @brief CameraDevice::startTrace
+ * @param file trace file, by default a new file in the application data traces directory
+ * @return true if tracing was started
+ *
+ * Record all camera control traffic into a binary trace, see CameraTrace.
+ */
+bool CameraDevice::startTrace(const QString &file)
+{
+    QString path=file;
+
+    if (path.isEmpty()) {
+        const QString dir=QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)+"/traces";
+        QDir().mkpath(dir);
+
+        QString address=m_address;
+        address.remove(':');
+
+        path=QStringLiteral("%1/trace-%2-%3.cptrace").arg(dir, address.isEmpty() ? "camera" : address,
+                                                           QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
     }
+
+    if (!m_trace)
+        m_trace=new CameraTrace(this);
+
+    const bool ok=m_trace->open(path);
+
+    if (ok)
+        qCDebug(lcGatt) << "Tracing to" << path;
+
+    emit tracingChanged();
+
+    return ok;
 }
 
-void CameraDevice::connectDevice(QBluetoothDeviceInfo *device)
+void CameraDevice::stopTrace()
 {
-    if (device->isValid())
-        scanServices(*device);
+    if (!m_trace || !m_trace->isOpen())
+        return;
+
+    qCDebug(lcGatt) << "Trace saved to" << m_trace->fileName();
+
+    m_trace->close();
+    emit tracingChanged();
 }
 
-void CameraDevice::scanServices(const QBluetoothDeviceInfo &device)
+bool CameraDevice::tracing() const
 {
-    qDebug() << "Scanning for BM services for " << device.name();
+    return m_trace && m_trace->isOpen();
+}
 
-    if (m_controller) {
-        m_controller->disconnectFromDevice();
-        delete m_controller;
-        m_controller = nullptr;
-    }
-    
-    if (m_currentDevice) {
-        delete m_currentDevice;
-        m_currentDevice=nullptr;
-    }
-    m_currentDevice=new QBluetoothDeviceInfo(device);
+void CameraDevice::deviceConnected()
+{
+    m_connected = true;
+    emit connectedChanged();
+    setConnectionState(Connected);
 
-    if (!m_controller) {
-        m_controller = QLowEnergyController::createCentral(*m_currentDevice, this);
+    updateField<&CameraDevice::m_name, &CameraDevice::nameChanged>(m_transport->name());
 
-        connect(m_controller, &QLowEnergyController::connected, this, &CameraDevice::deviceConnected);
-        connect(m_controller, &QLowEnergyController::errorOccurred, this, &CameraDevice::errorReceived);
-        connect(m_controller, &QLowEnergyController::disconnected, this, &CameraDevice::deviceDisconnected);
-        connect(m_controller, &QLowEnergyController::serviceDiscovered, this, &CameraDevice::addLowEnergyService);
-        connect(m_controller, &QLowEnergyController::discoveryFinished, this, &CameraDevice::serviceScanDone);
-    }
+    m_address=m_transport->address();
+    loadCachedState();
+}
+
+/**
+ * @brief CameraDevice::deviceReady
+ *
+ * Camera control is available, after a reconnect restore the last commanded state.
+ */
+void CameraDevice::deviceReady()
+{
+    m_connectTimer.stop();
+
+    setConnectionState(Ready);
+
+    updateWriteSize();
 
-    m_controller->setRemoteAddressType(QLowEnergyController::PublicAddress);
+    m_connectionPolicy->start();
+    m_connectionPolicy->setRecording(m_recording);
 
-    qDebug() << "Connecting to " << device.name();
-    m_controller->connectToDevice();
+    if (m_replayPending && m_replayState)
+        replayCommands();
+
+    m_replayPending=false;
+    m_reconnectAttempts=0;
 }
 
-void CameraDevice::scanServices(const QString &address)
+void CameraDevice::deviceConnectionFailure()
 {
-    if (m_cameras.contains(address)) {
-        m_currentDevice=m_cameras.value(address);
-    } else {
-        qWarning() << "Device not discovered" << address;
+    if (m_connectionState==Reconnecting) {
+        scheduleReconnect();
         return;
     }
 
-    if (!m_currentDevice->isValid()) {
-        qWarning() << "Not a valid device";
+    setConnectionState(Disconnected);
+    emit connectionFailure();
+}
+
+void CameraDevice::setConnectionState(ConnectionState state)
+{
+    if (m_connectionState==state)
         return;
-    }
 
-    scanServices(*m_currentDevice);
+    qCDebug(lcGatt) << "Connection state" << m_connectionState << "->" << state;
+
+    m_connectionState=state;
+    emit connectionStateChanged();
 }
 
-void CameraDevice::addLowEnergyService(const QBluetoothUuid &serviceUuid)
+/**
+ * @brief CameraDevice::scheduleReconnect
+ *
+ * Try to reconnect with exponential backoff, give up after ReconnectAttempts tries.
+ */
+void CameraDevice::scheduleReconnect()
 {
-    qDebug() << "Service discovered" << serviceUuid;
-    QLowEnergyService *service = m_controller->createServiceObject(serviceUuid);
-    if (!service) {
-        qWarning() << "Cannot create service for uuid";
+    m_connectTimer.stop();
+
+    if (m_reconnectTimer.isActive())
+        return;
+
+    if (m_reconnectAttempts>=ReconnectAttempts) {
+        qCWarning(lcGatt, "Giving up reconnecting");
+        m_reconnectAttempts=0;
+        setConnectionState(Disconnected);
+        emit connectionFailure();
         return;
     }
-    
-    qDebug() << "Service:" << service->serviceUuid() << service->state();
 
-    m_services.append(service);    
+    const int delay=qMin(ReconnectDelayMax, ReconnectDelay << m_reconnectAttempts);
+    m_reconnectAttempts++;
+    m_replayPending=true;
+
+    qCDebug(lcGatt) << "Reconnecting in" << delay << "ms, attempt" << m_reconnectAttempts;
+
+    setConnectionState(Reconnecting);
+    m_reconnectTimer.start(delay);
 }
 
-void CameraDevice::serviceScanDone()
+void CameraDevice::reconnect()
 {
-    qDebug() << "Services discovered";
-    // xxx error
-    if (m_services.isEmpty()) {        
-        qDebug() << "No services found ?";
+    if (!m_transport || m_userDisconnect)
         return;
-    }
 
-    qDebug() << "Connecting to camera service" << BmdCameraService.toString();
+    m_connectTimer.start();
+    m_transport->connectToDevice(m_device);
+}
+
+void CameraDevice::replayCommands()
+{
+    if (m_replay.isEmpty())
+        return;
 
-    connectToService(BmdCameraService.toString());
+    qCDebug(lcTx) << "Replaying" << m_replay.size() << "commands";
+
+    beginBatch();
+    for (const CutePocket::Command &cmd : std::as_const(m_replay))
+        m_queue->enqueue(cmd);
+    commitBatch();
 }
 
-void CameraDevice::connectToService(const QString &uuid)
+void CameraDevice::setAutoReconnect(bool autoReconnect)
 {
-    QLowEnergyService *service = nullptr;
-    for (QLowEnergyService *s: std::as_const(m_services)) {
-        if (s->serviceUuid().toString() == uuid) {
-            service = s;
-            break;
-        }
-    }
+    if (m_autoReconnect==autoReconnect)
+        return;
 
-    if (!service)
+    m_autoReconnect=autoReconnect;
+    emit autoReconnectChanged();
+}
+
+/**
+ * @brief CameraDevice::setUnacknowledgedWrites
+ * @param unacknowledged
+ *
+ * Send focus, zoom and colour correction without waiting for write responses, if the transport supports it.
+ */
+void CameraDevice::setUnacknowledgedWrites(bool unacknowledged)
+{
+    if (m_unacknowledgedWrites==unacknowledged)
         return;
 
-    if (service->state() == QLowEnergyService::RemoteService) {
-        connect(service, &QLowEnergyService::stateChanged, this, &CameraDevice::serviceDetailsDiscovered);
-        service->discoverDetails(QLowEnergyService::FullDiscovery); //xxx QLowEnergyService::FullDiscovery / SkipValueDiscovery        
-    } else if (service->state() == QLowEnergyService::RemoteServiceDiscovered) {
-        serviceDetailsDiscovered(QLowEnergyService::RemoteServiceDiscovered);
-    } else {
-        qWarning() << "connectToService" << service->state();
-    }
+    m_unacknowledgedWrites=unacknowledged;
+    emit unacknowledgedWritesChanged();
 }
 
-void CameraDevice::deviceConnected()
+/**
+ * @brief CameraDevice::maximumWriteSize
+ * @return largest command batch written as one packet on the current connection
+ */
+int CameraDevice::maximumWriteSize() const
 {
-    qDebug() << "Connected, discovering services";
+    return m_queue->maximumPacketSize();
+}
 
-    m_connected = true;
-    m_controller->discoverServices();
-    emit connectedChanged();
+/**
+ * @brief CameraDevice::updateWriteSize
+ *
+ * Size command batches to the transport write size, tracked per connection as the MTU is negotiated.
+ */
+void CameraDevice::updateWriteSize()
+{
+    if (!m_transport)
+        return;
+
+    const int size=m_queue->maximumPacketSize();
 
-    m_name=m_currentDevice->name();
-    emit nameChanged();
+    m_queue->setMaximumPacketSize(m_transport->maximumWriteSize());
+
+    if (m_queue->maximumPacketSize()==size)
+        return;
+
+    qCDebug(lcTx) << "Command packet size" << m_queue->maximumPacketSize();
+
+    emit maximumWriteSizeChanged();
 }
 
-void CameraDevice::errorReceived(QLowEnergyController::Error error)
+void CameraDevice::setReplayState(bool replay)
 {
-    switch (error) {
-    case QLowEnergyController::RemoteHostClosedError:
-        deviceDisconnected();
-        break;
-    case QLowEnergyController::ConnectionError:
-        emit connectionFailure();
-        break;
-    default:
-        qDebug() << "errorReceived" << error << m_controller->errorString();    
-    }
+    if (m_replayState==replay)
+        return;
+
+    m_replayState=replay;
+    emit replayStateChanged();
+}
+
+/**
+ * @brief CameraDevice::loadCachedState
+ *
+ * Show the last known state of the camera right away, the camera will update it with notifications.
+ */
+void CameraDevice::loadCachedState()
+{
+    QSettings settings;
+
+    settings.beginGroup("cameras");
+    settings.beginGroup(QString(m_address).remove(':'));
+
+    if (settings.childKeys().isEmpty())
+        return;
+
+    updateField<&CameraDevice::m_wb, &CameraDevice::wbChanged>(qint16(settings.value("wb", m_wb).toInt()));
+    updateField<&CameraDevice::m_tint, &CameraDevice::tintChanged>(qint16(settings.value("tint", m_tint).toInt()));
+    updateField<&CameraDevice::m_iso, &CameraDevice::isoChanged>(settings.value("iso", m_iso).toInt());
+    updateField<&CameraDevice::m_shutterSpeed, &CameraDevice::shutterSpeedChanged>(settings.value("shutterSpeed", m_shutterSpeed).toInt());
+    updateField<&CameraDevice::m_aperture, &CameraDevice::apertureChanged>(settings.value("aperture", m_aperture).toDouble());
+    updateField<&CameraDevice::m_zoom, &CameraDevice::zoomChanged>(qint16(settings.value("zoom", m_zoom).toInt()));
+    updateField<&CameraDevice::m_timecodeDisplay, &CameraDevice::timecodeDisplayChanged>(settings.value("timecodeDisplay", m_timecodeDisplay).toBool());
+    updateField<&CameraDevice::m_meta_camera_id, &CameraDevice::metaCameraIDChanged>(settings.value("cameraID").toString());
+    updateField<&CameraDevice::m_meta_lens_type, &CameraDevice::metaLensTypeChanged>(settings.value("lensType").toString());
+}
+
+void CameraDevice::saveCachedState()
+{
+    if (m_address.isEmpty())
+        return;
+
+    QSettings settings;
+
+    settings.beginGroup("cameras");
+    settings.beginGroup(QString(m_address).remove(':'));
+
+    settings.setValue("wb", m_wb);
+    settings.setValue("tint", m_tint);
+    settings.setValue("iso", m_iso);
+    settings.setValue("shutterSpeed", m_shutterSpeed);
+    settings.setValue("aperture", m_aperture);
+    settings.setValue("zoom", m_zoom);
+    settings.setValue("timecodeDisplay", m_timecodeDisplay);
+    settings.setValue("cameraID", m_meta_camera_id);
+    settings.setValue("lensType", m_meta_lens_type);
 }
 
 void CameraDevice::disconnectFromDevice()
 {
-    qDebug() << "State is " << m_controller->state();
-    
-    if (m_controller->state() != QLowEnergyController::UnconnectedState) {
-        qDebug() << "Disconnecting from device";
-        m_controller->disconnectFromDevice();
-    } else {
-        qDebug() << "Not connected ?";
+    m_userDisconnect=true;
+    m_reconnectTimer.stop();
+    m_connectTimer.stop();
+
+    if (m_connectionState==Reconnecting)
+        setConnectionState(Disconnected);
+
+    if (m_transport)
+        m_transport->disconnectFromDevice();
+    else
         deviceDisconnected();
-    }
 }
 
 bool CameraDevice::setCameraName(const QString name)
@@ -205,593 +539,377 @@ bool CameraDevice::setCameraName(const QString name)
     return writeCameraName(name);
 }
 
+/**
+ * @brief CameraDevice::beginBatch
+ *
+ * Commands issued until commitBatch() are packed together into as few writes as possible.
+ */
+void CameraDevice::beginBatch()
+{
+    m_queue->hold();
+}
+
+void CameraDevice::commitBatch()
+{
+    m_queue->resume();
+}
+
 void CameraDevice::deviceDisconnected()
 {
-    qWarning() << "Disconnect from device";
-    if (m_cameraOutgoing) {
-        delete m_cameraOutgoing;
-        m_cameraOutgoing=nullptr;
+    qCDebug(lcGatt) << "Disconnect from device";
+    m_queue->clear();
+    m_latency->clearPending();
+    m_connectionPolicy->reset();
+
+    if (m_connected) {
+        saveCachedState();
+        CutePocket::logPacketCounters(m_packetCounters);
+        m_packetCounters.reset();
+        qCInfo(lcRx) << "Property notifications" << notifyStats();
     }
 
-    m_name="";
-    emit nameChanged();
+    updateField<&CameraDevice::m_name, &CameraDevice::nameChanged>(QString());
+    m_timecode->reset();
     
+    const bool wasConnected=m_connected;
+
     m_connected=false;
     emit connectedChanged();
     emit disconnected();
+
+    if (!m_userDisconnect && m_autoReconnect && m_transport && (wasConnected || m_connectionState==Reconnecting))
+        scheduleReconnect();
+    else
+        setConnectionState(Disconnected);
 }
 
-void CameraDevice::serviceDetailsDiscovered(QLowEnergyService::ServiceState newState)
+/**
+ * @brief CameraDevice::notify
+ * @param changed
+ *
+ * Emit the notify signal only if the value changed, counting emitted and suppressed notifications.
+ */
+template<auto Notify>
+void CameraDevice::notify(bool changed)
 {
-    qDebug() << "serviceDetailsDiscovered" << newState;
+    static const int index=QMetaMethod::fromSignal(Notify).methodIndex();
 
-    auto service = qobject_cast<QLowEnergyService *>(sender());
-    if (!service) {
-        qDebug() << "... invalid service?";
-        qDebug() << "State is " << m_controller->state();
-        return;
-    }
+    if (m_notifyCounters.size()<=index)
+        m_notifyCounters.resize(metaObject()->methodCount());
 
-    if (service->state()==QLowEnergyService::RemoteServiceDiscovering) {
-        const QList<QLowEnergyCharacteristic> chars = service->characteristics();
-        qDebug() << "Service: " << service->serviceName() << service->serviceUuid() << chars.size();
-        
-        for (const QLowEnergyCharacteristic &ch : chars) {
-            qDebug() << "QLowEnergyCharacteristic" << ch.uuid() << ch.value() << ch.value().size() << ch.value().toHex(':');
-        }
-        return;
-    }
-    
-    if (service->state()==QLowEnergyService::InvalidService) {
-        qDebug() << "Invalid service, disconnected from device ?";
-        qDebug() << "State is " << m_controller->state();
-        return;
-    }
-    
-    const QList<QLowEnergyCharacteristic> chars = service->characteristics();
-    qDebug() << "Service: " << service->serviceName() << service->serviceUuid();
-
-    connect(service, &QLowEnergyService::stateChanged, this, &CameraDevice::serviceStateChanged);
-    connect(service, &QLowEnergyService::characteristicChanged, this, &CameraDevice::characteristicChanged);
-    connect(service, &QLowEnergyService::descriptorWritten, this, &CameraDevice::confirmedDescriptorWrite);
-
-    m_cameraService=service;
-
-    for (const QLowEnergyCharacteristic &ch : chars) {
-        qDebug() << "QLowEnergyCharacteristic" << ch.uuid() << ch.value() << ch.value().size() << ch.value().toHex(':');
-
-        QLowEnergyDescriptor desc = ch.descriptor(QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration);
-
-        if (ch.uuid()==OutgoingCameraControl) {
-            qDebug() << "Found OutgoingCameraControl!";
-            m_cameraOutgoing=new QLowEnergyCharacteristic(ch);
-        } else if (ch.uuid()==DeviceName) {
-            qDebug() << "Found DeviceName!";
-            m_cameraName=new QLowEnergyCharacteristic(ch);
-        } else if (ch.uuid()==CameraStatus) {
-            // XXX: Seems under Windows we get the value already here and it won't update later from a notification ?
-            if (!ch.value().isNull()) {
-                m_status=ch.value().at(0);
-                qDebug() << "CameraStatus" << m_status;
-                emit statusChanged();
-            }
-        } else {
-            qDebug() << "Unhandled" << ch.uuid();
-        }
+    NotifyCounter &c=m_notifyCounters[index];
 
-        uint permission = ch.properties();
-        if ((permission & QLowEnergyCharacteristic::Notify)) {
-            qDebug() << "Enabling notifications for " << ch.uuid() << ch.value().toHex(':');
-            service->writeDescriptor(desc, QLowEnergyCharacteristic::CCCDEnableNotification);
-        } else if (permission & QLowEnergyCharacteristic::Indicate) {
-            qDebug() << "Enabling indications for " << ch.uuid() << ch.value().toHex(':');
-            service->writeDescriptor(desc, QLowEnergyCharacteristic::CCCDEnableIndication);
-        } else if (permission & QLowEnergyCharacteristic::Write) {
-            qDebug() << "WriteCharacteristics" << ch.uuid();
-        }
+    if (changed) {
+        c.emitted++;
+        emit (this->*Notify)();
+    } else {
+        c.suppressed++;
     }
 }
 
 /**
- * @brief CameraDevice::handleLensData
- * @param data
+ * @brief CameraDevice::updateField
+ * @param value
+ * @return true if the value changed
+ *
+ * Compare-and-notify setter for camera state.
  */
-void CameraDevice::handleLensData(const QByteArray &data)
-{
-    uint16_t v;
-        
-    switch (data.at(5)) {
-    case 0: // Focus
-        v = CutePocket::uint16at(data, 8);
-        
-        qDebug() << "Focus norm" <<v << data.toHex(':');
-        break;
-    case 1:
-        qDebug() << "AutoFocus triggered" << data.toHex(':');
-        
-        emit autoFocusTriggered();
-        break;
-    case 2: // Aperture f-stop
-    {
-        uint16_t v =  CutePocket::uint16at(data, 8);
-
-        m_aperture = sqrt(pow(2.0f, ((double)(v) / 2048.0f)));
-        qDebug() << "Aperture raw" << data.toHex(':') << v << m_aperture;
-        
-        m_aperture=round(m_aperture*10.0f)/10.0f;
-        
-        qDebug() << "Rounded"<< m_aperture;
-
-        emit apertureChanged();
-    }
-        break;
-    case 3: // Aperture normalized
-        v = CutePocket::uint16at(data, 8); // data[8] + (data[9] << 8);
-        qDebug() << "Aperture norm" << data.toHex(':') << v;
-        m_aperture_norm=v;
-    break;
-    case 6:
-        qDebug() << "OIS" << data.toHex(':');
-        break;
-    case 7: // Zoom mm
-        m_zoom = CutePocket::uint16at(data, 8);
-        emit zoomChanged();
-        qDebug() << "Zoom" << data.toHex(':') << m_zoom;
-        break;
-    case 8: // Zoom normalized
-        v = CutePocket::uint16at(data, 8);
-        qDebug() << "Zoom normalized" << v << data.toHex(':');
-        break;
-    case 9: // Zoom continuous
-        qDebug() << "Zooming" << data.toHex(':');
-        break;
-    default:
-        qDebug() << "Unknown lens data" << data.toHex(':') << data.toStdString();
-    }
+template<auto Field, auto Notify, typename V>
+bool CameraDevice::updateField(const V &value)
+{
+    auto &field=this->*Field;
+    const bool changed=!(field==value);
+
+    if (changed)
+        field=value;
+
+    if constexpr (Notify!=nullptr)
+        notify<Notify>(changed);
+
+    return changed;
 }
 
-/**
- * @brief CameraDevice::handleVideoData
- * @param data
- */
-void CameraDevice::handleVideoData(const QByteArray &data)
-{
-    quint8 c=data.at(5);
-    switch (c) {
-    case 0: // Video mode
-        qDebug() << "Mode" << data.toHex(':');
-        break;
-    case 2: // WB
-        m_wb=CutePocket::int16at(data, 8);
-        m_tint=CutePocket::int16at(data, 10);
-        qDebug() << "WB" << data.toHex(':') << m_wb << m_tint;
-        
-        emit wbChanged();
-        emit tintChanged();
-        break;
-    case 3:
-        qDebug() << "AutoWB Triggered";
-        break;
-    case 4:
-        qDebug() << "AutoWB Restored";
-        break;
-    case 5:
-        m_exposure=CutePocket::int32at(data, 8);
-        qDebug() << "Exposure" << data.toHex(':') << m_exposure;
-        break;
-    case 7:
-        qDebug() << "DRM" << data.toHex(':');
-        break;
-    case 8:
-        qDebug() << "Sharpening" << data.toHex(':');
-        break;
-    case 9:
-        qDebug() << "Format" << data.toHex(':');
-        break;
-    case 10:
-        m_autoExposureMode=data.at(8);
-        qDebug() << "AutoExposureMode" << m_autoExposureMode;
-        break;
-    case 11:
-        qDebug() << "Shutter Angle" << data.toHex(':');
-        break;
-    case 12:
-        qDebug() << "Shutter speed" << data.toHex(':');
-        m_shutterSpeed=CutePocket::int32at(data, 8);
-        emit shutterSpeedChanged();
-        break;
-    case 13:
-        qDebug() << "Gain" << data.toHex(':');
-        break;
-    case 14:
-        m_iso=CutePocket::int32at(data, 8);
-        qDebug() << "ISO" << data.toHex(':') << m_iso;
-        emit isoChanged();
-        break;
-    case 15:
-        qDebug() << "LUT" << data.toHex(':');
-        break;
-    case 16:
-        qDebug() << "ND" << data.toHex(':');
-        break;    
-    default:
-        qDebug() << "Unknown video data" << c << data.toHex(':');
-    }
+template<auto Field, auto Notify>
+void CameraDevice::decodeField(const CutePocket::Message &msg)
+{
+    using T = std::remove_reference_t<decltype(this->*Field)>;
+
+    if constexpr (std::is_same_v<T, QString>)
+        updateField<Field, Notify>(msg.string());
+    else if constexpr (std::is_floating_point_v<T>)
+        updateField<Field, Notify>(msg.type==CutePocket::Fixed16Type ? msg.fixed() : static_cast<T>(msg.integer()));
+    else if constexpr (std::is_same_v<T, bool>)
+        updateField<Field, Notify>(msg.integer()!=0);
+    else
+        updateField<Field, Notify>(static_cast<T>(msg.integer()));
 }
 
 /**
- * @brief CameraDevice::handleAudioData
- * @param data
+ * @brief CameraDevice::notifyStats
+ * @return emitted and suppressed notification counts for each property notify signal
  */
-void CameraDevice::handleAudioData(const QByteArray &data)
-{
-    switch (data.at(5)) {
-    case 1:
-        qDebug() << "Headphone level" << data.toHex(':');
-        break;
-    case 2:
-        qDebug() << "Headphone program mix" << data.toHex(':');
-        break;
-    case 3:
-        qDebug() << "Input type" << data.toHex(':');
-        break;
-    case 4:
-        qDebug() << "Input levels" << data.toHex(':');
-        break;
-    case 6:
-        qDebug() << "Phantom power" << data.toHex(':');
-        break;
-    default:
-        qDebug() << "Unknown audio data" << data.toHex(':') << data.toStdString();
+QVariantMap CameraDevice::notifyStats() const
+{
+    QVariantMap stats;
+
+    for (int i=0; i<m_notifyCounters.size(); i++) {
+        const NotifyCounter &c=m_notifyCounters.at(i);
+
+        if (c.emitted==0 && c.suppressed==0)
+            continue;
+
+        stats.insert(QString::fromLatin1(metaObject()->method(i).name()),
+                     QVariantMap { { "emitted", c.emitted }, { "suppressed", c.suppressed } });
     }
+
+    return stats;
 }
 
-/**
- * @brief CameraDevice::handleOutputData
- * @param data
- */
-void CameraDevice::handleOutputData(const QByteArray &data)
+void CameraDevice::resetNotifyStats()
 {
-    quint8 c=data.at(5);
-    
-    switch (c) {
-    case 3:
-        qDebug() << "Overlays" << data.toHex(':');
-        m_guide_style=data.at(8);
-        m_guide_opacity=data.at(9);
-        m_safe_area=data.at(10);
-        m_grid_style=data.at(11);
-        
-        qDebug() << m_guide_style << m_guide_opacity << m_safe_area << m_grid_style;
-            
-        break;
-    default:
-        qDebug() << "Unknown output data" << c << data.toHex(':');
-    }
+    m_notifyCounters.clear();
 }
 
-/**
- * @brief CameraDevice::handleMediaData
- * @param data
- */
-void CameraDevice::handleMediaData(const QByteArray &data)
-{
-    switch (data.at(5)) {
-    case 0: // Codec
-        qDebug() << "Codec" << data.toHex(':');
-
-        m_codec=data.at(8);
-        m_codec_variant=data.at(9);
-        break;
-    case 1: // Transport mode
-        qDebug() << "Mode" << data.toHex(':');
-        m_recording=data.at(8)==2 ? true : false;
-        emit recordingChanged();
-
-        m_playing=data.at(8)==1 ? true : false;
-        emit playingChanged();
-        
-        m_media_speed=data.at(9);
-        m_media_slot_1=data.at(10);
-        m_media_slot_2=data.at(11);
-        
-        qDebug() << "Media" << m_media_speed << m_media_slot_1 << m_media_slot_2;
-        break;
-    case 2: // Playback
-        qDebug() << "Playback" << data.toHex(':');
-        break;
-    case 3:
-        qDebug() << "Capture" << data.toHex(':');
-        break;
-    default:
-        qDebug() << "Unknown video data" << data.toHex(':') << data.toStdString();
-    }
+void CameraDevice::handleAutoFocus(const CutePocket::Message &msg)
+{
+    Q_UNUSED(msg)
+
+    qCDebug(lcRx) << "AutoFocus triggered";
+
+    emit autoFocusTriggered();
 }
 
-/**
- * @brief CameraDevice::handleDisplayData
- * @param data
- */
-void CameraDevice::handleDisplayData(const QByteArray &data)
-{
-    switch (data.at(5)) {
-    case 0:
-        qDebug() << "Brightness" << data.toHex(':');
-        break;
-    case 1:
-        qDebug() << "Exposure and focus tools" << data.toHex(':');
-        break;
-    case 2:
-        qDebug() << "Zebra level" << data.toHex(':');
-        break;
-    case 3:
-        qDebug() << "Peaking level" << data.toHex(':');
-        break;
-    case 4:
-        qDebug() << "Color bar" << data.toHex(':');
-        break;
-    case 5:
-        qDebug() << "Focus assist" << data.toHex(':');
-        break;
-    case 6:
-        qDebug() << "Return feed" << data.toHex(':');
-        break;
-    case 7:
-        qDebug() << "Time display (?)" << data.toHex(':');
-        m_timecodeDisplay=data.at(8)==1 ? true : false;
-        emit timecodeDisplayChanged();
-        break;
-    default:
-        qDebug() << "handleDisplayData" << data.toHex(':');
-    }
+void CameraDevice::handleAperture(const CutePocket::Message &msg)
+{
+    const qint16 v=msg.integer();
+
+    double aperture=CutePocket::apertureFromFixed16(v);
+    qCPacket(lcRx) << "Aperture raw" << v << aperture;
+
+    aperture=round(aperture*10.0f)/10.0f;
+
+    qCPacket(lcRx) << "Rounded"<< aperture;
+
+    updateField<&CameraDevice::m_aperture, &CameraDevice::apertureChanged>(aperture);
 }
 
-/**
- * @brief CameraDevice::handleTallyData
- * @param data
- */
-void CameraDevice::handleTallyData(const QByteArray &data)
+void CameraDevice::handleWhiteBalance(const CutePocket::Message &msg)
 {
-    qDebug() << "handleTallyData" << data.toHex(':');
+    updateField<&CameraDevice::m_wb, &CameraDevice::wbChanged>(qint16(msg.integer(0)));
+    updateField<&CameraDevice::m_tint, &CameraDevice::tintChanged>(qint16(msg.integer(1)));
+    qCPacket(lcRx) << "WB" << m_wb << m_tint;
 }
 
-/**
- * @brief CameraDevice::handleReferenceData
- * @param data
- */
-void CameraDevice::handleReferenceData(const QByteArray &data)
-{
-    switch (data.at(5)) {
-    case 0:
-        qDebug() << "Reference source" << data.toHex(':');
-        break;
-    case 1:
-        qDebug() << "Reference offset" << data.toHex(':');
-        break;
-    default:
-        qDebug() << "handleReferenceData" << data.toHex(':');
-    }
+void CameraDevice::handleOverlays(const CutePocket::Message &msg)
+{
+    m_guide_style=msg.integer(0);
+    m_guide_opacity=msg.integer(1);
+    m_safe_area=msg.integer(2);
+    m_grid_style=msg.integer(3);
+
+    qCPacket(lcRx) << "Overlays" << m_guide_style << m_guide_opacity << m_safe_area << m_grid_style;
 }
 
-/**
- * @brief CameraDevice::handleConfigData
- * @param data
- */
-void CameraDevice::handleConfigData(const QByteArray &data)
+void CameraDevice::handleCodec(const CutePocket::Message &msg)
 {
-    quint8 c=data.at(5);
-    qDebug() << "handleConfigData" << c << data.toHex(':');
+    m_codec=msg.integer(0);
+    m_codec_variant=msg.integer(1);
 }
 
-/**
- * @brief CameraDevice::handleColorData
- * @param data
- */
-void CameraDevice::handleColorData(const QByteArray &data)
+void CameraDevice::handleRecordingFormat(const CutePocket::Message &msg)
 {
-    double r,g,b,l;
-    uint16_t v;
-    qDebug() << "handleColorData" << data.toHex(':');
+    if (updateField<&CameraDevice::m_frameRate, &CameraDevice::frameRateChanged>(qint16(msg.integer(0))))
+        m_timecode->setFrameRate(m_frameRate);
+}
 
-    switch (data.at(5)) {
-    case 0: // Lift
-        v =  CutePocket::uint16at(data, 8);
-        r = sqrt(pow(2.0f, ((double)(v) / 2048.0f)));
+void CameraDevice::handleTransportMode(const CutePocket::Message &msg)
+{
+    const qint64 mode=msg.integer(0);
 
-        v =  CutePocket::uint16at(data, 8);
-        g = sqrt(pow(2.0f, ((double)(v) / 2048.0f)));
+    updateField<&CameraDevice::m_recording, &CameraDevice::recordingChanged>(mode==2);
+    m_connectionPolicy->setRecording(m_recording);
+    updateField<&CameraDevice::m_playing, &CameraDevice::playingChanged>(mode==1);
 
-        v =  CutePocket::uint16at(data, 8);
-        b = sqrt(pow(2.0f, ((double)(v) / 2048.0f)));
+    m_media_speed=msg.integer(1);
+    m_media_slot_1=msg.integer(2);
+    m_media_slot_2=msg.integer(3);
 
-        v =  CutePocket::uint16at(data, 8);
-        l = sqrt(pow(2.0f, ((double)(v) / 2048.0f)));
+    qCPacket(lcRx) << "Media" << mode << m_media_speed << m_media_slot_1 << m_media_slot_2;
 
-        qDebug() << "lift" << r << g << b << l;
-        break;
-    }
+    emit transportModeReceived();
 }
 
-/**
- * @brief CameraDevice::handleStatusData
- * @param data
- */
-void CameraDevice::handleStatusData(const QByteArray &data)
-{
-    switch (data.at(5)) {
-    case 0: // ?
-    {
-        uint8_t ticker=data.at(8);
-        uint8_t charge=data.at(9);
-        uint8_t power=data.at(12); // 1b=ac/psu, 0b=volt/psu, 19=volt/battery, 09=no/psu
-        
-        qDebug() << "Status" << ticker << power << charge << data.toHex(':');
-    }
-        break;
-    case 1: // USB-C attach + size ?
-        qDebug() << "statusUSB" << data.toHex(':');
-        break;
-    case 2: // Time left?
-        qDebug() << "statusTimeLeft" << data.toHex(':');
-        break;
-    case 7: // Assists ? (focus color, level, type)
-        qDebug() << "statusAssists" << data.toHex(':');
-        break;
-    default:
-        qDebug() << "handleStatusData" << data.toHex(':');
-    }
+void CameraDevice::handleTake(const CutePocket::Message &msg)
+{
+    updateField<&CameraDevice::m_meta_take_number, &CameraDevice::metaTakeNumberChanged>(qint8(msg.integer(0)));
+    m_meta_take_tags=msg.integer(1);
+}
+
+void CameraDevice::handleColorCorrection(const CutePocket::Message &msg)
+{
+    m_colorCorrection->decode(msg);
 }
 
 
+static int bcdtoint(uint8_t v) { return v-6*(v >> 4); }
+
+void CameraDevice::handleTimecodeData(const QByteArray &value)
+{
+    CutePocket::count(m_packetCounters.timecodes);
+
+    if (m_trace)
+        m_trace->record(CameraTrace::Rx, CameraTrace::Timecode, value);
+
+    if (value.size()<12)
+        return;
+
+    // BCD frames, seconds, minutes, hours
+    const quint32 tc=Wire::load<quint32>(Wire::bytes(value), 8);
+
+    m_timecode->setTimecode(bcdtoint(tc >> 24), bcdtoint((tc >> 16) & 0xff), bcdtoint((tc >> 8) & 0xff), bcdtoint(tc & 0xff));
+}
+
 /**
- * @brief CameraDevice::handleMetaData
- * @param data
+ * @brief CameraDevice::timecodeFrames
+ * @return last received timecode as frames since midnight, -1 if the frame rate is not known
  */
-void CameraDevice::handleMetaData(const QByteArray &data)
+qint64 CameraDevice::timecodeFrames() const
 {
-    QString str;
-    
-    quint8 c=data.at(5);
-    switch (c) {
-    case 0: // Reel
-        qDebug() << "handleMetaData Reel" << data.toHex(':');
-        break;
-    case 1: // Scene tags
-        qDebug() << "handleMetaData Scene tag" << data.toHex(':');
-        break;
-    case 2: // Scene
-        m_meta_scene=data.mid(8);
-        break;
-    case 3: // Take
-        m_meta_take_number=data.at(8);
-        emit metaTakeNumberChanged();
-        m_meta_take_tags=data.at(9);
-        break;
-    case 4:
-        qDebug() << "handleMetaData (4)?" << data.toHex(':');
-        break;
-    case 5: // ID
-        m_meta_camera_id=data.mid(8);
-        emit metaCameraIDChanged();
-        break;
-    case 6: // Operator
-        m_meta_camera_operator=data.mid(8);
-        emit metaCameraOperatorChanged();
-        break;
-    case 7: // Director
-        m_meta_director=data.mid(8);
-        emit metaDirectorChanged();
-        break;
-    case 8: // Name
-        m_meta_project_name=data.mid(8);
-        emit metaProjectNameChanged();
-        break;
-    case 9: // Lens type
-        m_meta_lens_type=data.mid(8);
-        emit metaLensTypeChanged();
-        break;
-    case 10: // Iris
-        m_meta_lens_iris=data.mid(8);
-        emit metaLensIrisChanged();
-        break;
-    case 11: // Focal length
-        m_meta_lens_focal=data.mid(8);
-        emit metaLensFocalChanged();
-        break;
-    case 12: // Distance
-        m_meta_lens_distance=data.mid(8);
-        emit metaLensDistanceChanged();
-        break;
-    case 13: // Filter
-        m_meta_lens_filter=data.mid(8);
-        emit metaLensFilterChanged();
-        break;
-    case 14: // Slate mode
-        m_meta_slate_mode=data.at(8);
-        emit metaSlateModeChanged();
-        break;
-    case 15: // Slate target
-        m_meta_slate_target=data.mid(8);
-        emit metaSlateTargetChanged();
-        break;
-    default:
-        qDebug() << "handleMetaData unknown" << c << data.toHex(':');
-    }    
+    return m_timecode->receivedFrames();
 }
 
-static int bcdtoint(uint8_t v) { return v-6*(v >> 4); }
+void CameraDevice::handleCameraStatus(const QByteArray &value)
+{
+    if (m_trace)
+        m_trace->record(CameraTrace::Rx, CameraTrace::Status, value);
 
-void CameraDevice::characteristicChanged(QLowEnergyCharacteristic characteristic, QByteArray value)
-{
-    //qDebug() << "characteristicChanged" << characteristic.name() << characteristic.uuid() << value.toHex(':');
-    if (characteristic.uuid()==Timecode) {
-        uint8_t h,m,s,f;
-        h=value.at(11);
-        m=value.at(10);
-        s=value.at(9);
-        f=value.at(8);
-        m_timecode.setHMS(bcdtoint(h),bcdtoint(m), bcdtoint(s) ,bcdtoint(f));
-        emit timecodeChanged();
-    } else if (characteristic.uuid()==IncomingCameraControl && (quint8)value[0]==255) {
-        quint8 c=value.at(4);
-        switch (c) {
-        case 0: // Lens
-            handleLensData(value);
-            break;
-        case 1: // Video
-            handleVideoData(value);
-            break;
-        case 2: // Audio
-            handleAudioData(value);
-            break;
-        case 3: // Output
-            handleOutputData(value);
-            break;
-        case 4: // Display
-            handleDisplayData(value);
-            break;
-        case 5: // Tally
-            handleTallyData(value);
-            break;
-        case 6: // Reference
-            handleReferenceData(value);
-            break;
-        case 7: // Config
-            handleConfigData(value);
-            break;
-        case 8: // Color correction
-            handleColorData(value);
-            break;
-        case 9: // Undocumented, status/power related ?
-            handleStatusData(value);
-            break;
-        case 10: // Media
-            handleMediaData(value);
-            break;
-        case 11: // PTZ
-            // handlePTZData(value);
-            break;
-        case 12: // Metadata
-            handleMetaData(value);
-            break;
-        default:
-            qDebug() << "Unknown category" << c << value.at(5) << value.toHex(':');
-        }
-    } else if (characteristic.uuid()==CameraStatus) {
-        m_status=value.at(0);
-        qDebug() << "CameraStatus" << value.toHex(':') << m_status;
-        emit statusChanged();
-    }
+    if (value.isEmpty())
+        return;
+
+    qCPacket(lcRx) << "CameraStatus" << value.toHex(':');
+    updateField<&CameraDevice::m_status, &CameraDevice::statusChanged>(qint8(value.at(0)));
 }
 
-void CameraDevice::serviceStateChanged(QLowEnergyService::ServiceState s)
+/**
+ * @brief CameraDevice::handleControlData
+ * @param value
+ *
+ * Decode all messages in an incoming camera control packet. Adding a parameter is one line in the table,
+ * with a generic decodeField handler for plain values.
+ */
+void CameraDevice::handleControlData(const QByteArray &value)
 {
-    qDebug() << "serviceStateChanged" << s;
+    using namespace CutePocket;
+
+    count(m_packetCounters.rxPackets);
+    count(m_packetCounters.rxBytes, value.size());
+
+    if (m_trace)
+        m_trace->record(CameraTrace::Rx, CameraTrace::Control, value);
+
+    static constexpr ParameterDescriptor<CameraDevice> parameters[] = {
+        // Lens
+        { 0, 0, Fixed16Type, 1, "Focus", nullptr },
+        { 0, 1, VoidType, 0, "Instantaneous autofocus", &CameraDevice::handleAutoFocus },
+        { 0, 2, Fixed16Type, 1, "Aperture f-stop", &CameraDevice::handleAperture },
+        { 0, 3, Fixed16Type, 1, "Aperture normalized", &CameraDevice::decodeField<&CameraDevice::m_aperture_norm, nullptr> },
+        { 0, 6, VoidType, 0, "OIS", nullptr },
+        { 0, 7, Int16Type, 1, "Zoom", &CameraDevice::decodeField<&CameraDevice::m_zoom, &CameraDevice::zoomChanged> },
+        { 0, 8, Fixed16Type, 1, "Zoom normalized", nullptr },
+        { 0, 9, Fixed16Type, 1, "Zoom continuous", nullptr },
+        // Video
+        { 1, 0, Int8Type, 5, "Video mode", nullptr },
+        { 1, 2, Int16Type, 2, "White balance", &CameraDevice::handleWhiteBalance },
+        { 1, 3, VoidType, 0, "AutoWB triggered", nullptr },
+        { 1, 4, VoidType, 0, "AutoWB restored", nullptr },
+        { 1, 5, Int32Type, 1, "Exposure", &CameraDevice::decodeField<&CameraDevice::m_exposure, nullptr> },
+        { 1, 7, Int8Type, 1, "Dynamic range mode", nullptr },
+        { 1, 8, Int8Type, 1, "Sharpening", nullptr },
+        { 1, 9, Int16Type, 1, "Recording format", &CameraDevice::handleRecordingFormat },
+        { 1, 10, Int8Type, 1, "Auto exposure mode", &CameraDevice::decodeField<&CameraDevice::m_autoExposureMode, nullptr> },
+        { 1, 11, Int32Type, 1, "Shutter angle", nullptr },
+        { 1, 12, Int32Type, 1, "Shutter speed", &CameraDevice::decodeField<&CameraDevice::m_shutterSpeed, &CameraDevice::shutterSpeedChanged> },
+        { 1, 13, Int8Type, 1, "Gain", nullptr },
+        { 1, 14, Int32Type, 1, "ISO", &CameraDevice::decodeField<&CameraDevice::m_iso, &CameraDevice::isoChanged> },
+        { 1, 15, Int8Type, 2, "LUT", nullptr },
+        { 1, 16, Fixed16Type, 0, "ND", nullptr },
+        // Audio
+        { 2, 1, Fixed16Type, 0, "Headphone level", nullptr },
+        { 2, 2, Fixed16Type, 0, "Headphone program mix", nullptr },
+        { 2, 3, Int8Type, 0, "Input type", nullptr },
+        { 2, 4, Fixed16Type, 0, "Input levels", nullptr },
+        { 2, 6, VoidType, 0, "Phantom power", nullptr },
+        // Output
+        { 3, 3, Int8Type, 4, "Overlays", &CameraDevice::handleOverlays },
+        // Display
+        { 4, 0, Fixed16Type, 0, "Brightness", nullptr },
+        { 4, 1, Int16Type, 0, "Exposure and focus tools", nullptr },
+        { 4, 2, Fixed16Type, 0, "Zebra level", nullptr },
+        { 4, 3, Fixed16Type, 0, "Peaking level", nullptr },
+        { 4, 4, Int8Type, 0, "Color bar", nullptr },
+        { 4, 5, Int8Type, 0, "Focus assist", nullptr },
+        { 4, 6, Int8Type, 0, "Return feed", nullptr },
+        { 4, 7, Int8Type, 1, "Time display", &CameraDevice::decodeField<&CameraDevice::m_timecodeDisplay, &CameraDevice::timecodeDisplayChanged> },
+        // Reference
+        { 6, 0, Int8Type, 0, "Reference source", nullptr },
+        { 6, 1, Int32Type, 0, "Reference offset", nullptr },
+        // Color correction
+        { 8, 0, Fixed16Type, 4, "Lift", &CameraDevice::handleColorCorrection },
+        { 8, 1, Fixed16Type, 4, "Gamma", &CameraDevice::handleColorCorrection },
+        { 8, 2, Fixed16Type, 4, "Gain", &CameraDevice::handleColorCorrection },
+        { 8, 3, Fixed16Type, 4, "Offset", &CameraDevice::handleColorCorrection },
+        { 8, 4, Fixed16Type, 2, "Contrast", &CameraDevice::handleColorCorrection },
+        { 8, 5, Fixed16Type, 1, "Luma mix", &CameraDevice::handleColorCorrection },
+        { 8, 6, Fixed16Type, 2, "Color adjust", &CameraDevice::handleColorCorrection },
+        // Undocumented, status/power related ?
+        { 9, 0, Int8Type, 0, "Status", nullptr },
+        { 9, 1, Int8Type, 0, "Status USB", nullptr },
+        { 9, 2, Int8Type, 0, "Status time left", nullptr },
+        { 9, 7, Int8Type, 0, "Status assists", nullptr },
+        // Media
+        { 10, 0, Int8Type, 2, "Codec", &CameraDevice::handleCodec },
+        { 10, 1, Int8Type, 4, "Transport mode", &CameraDevice::handleTransportMode },
+        { 10, 2, Int8Type, 0, "Playback", nullptr },
+        { 10, 3, VoidType, 0, "Capture", nullptr },
+        // Metadata
+        { 12, 0, Int16Type, 0, "Reel", nullptr },
+        { 12, 1, Int8Type, 0, "Scene tags", nullptr },
+        { 12, 2, StringType, 0, "Scene", &CameraDevice::decodeField<&CameraDevice::m_meta_scene, &CameraDevice::metaSceneChanged> },
+        { 12, 3, Int8Type, 2, "Take", &CameraDevice::handleTake },
+        { 12, 4, Int8Type, 0, "Good take", nullptr },
+        { 12, 5, StringType, 0, "Camera ID", &CameraDevice::decodeField<&CameraDevice::m_meta_camera_id, &CameraDevice::metaCameraIDChanged> },
+        { 12, 6, StringType, 0, "Camera operator", &CameraDevice::decodeField<&CameraDevice::m_meta_camera_operator, &CameraDevice::metaCameraOperatorChanged> },
+        { 12, 7, StringType, 0, "Director", &CameraDevice::decodeField<&CameraDevice::m_meta_director, &CameraDevice::metaDirectorChanged> },
+        { 12, 8, StringType, 0, "Project name", &CameraDevice::decodeField<&CameraDevice::m_meta_project_name, &CameraDevice::metaProjectNameChanged> },
+        { 12, 9, StringType, 0, "Lens type", &CameraDevice::decodeField<&CameraDevice::m_meta_lens_type, &CameraDevice::metaLensTypeChanged> },
+        { 12, 10, StringType, 0, "Lens iris", &CameraDevice::decodeField<&CameraDevice::m_meta_lens_iris, &CameraDevice::metaLensIrisChanged> },
+        { 12, 11, StringType, 0, "Lens focal length", &CameraDevice::decodeField<&CameraDevice::m_meta_lens_focal, &CameraDevice::metaLensFocalChanged> },
+        { 12, 12, StringType, 0, "Lens distance", &CameraDevice::decodeField<&CameraDevice::m_meta_lens_distance, &CameraDevice::metaLensDistanceChanged> },
+        { 12, 13, StringType, 0, "Lens filter", &CameraDevice::decodeField<&CameraDevice::m_meta_lens_filter, &CameraDevice::metaLensFilterChanged> },
+        { 12, 14, Int8Type, 1, "Slate mode", &CameraDevice::decodeField<&CameraDevice::m_meta_slate_mode, &CameraDevice::metaSlateModeChanged> },
+        { 12, 15, StringType, 0, "Slate target", &CameraDevice::decodeField<&CameraDevice::m_meta_slate_target, &CameraDevice::metaSlateTargetChanged> },
+    };
+
+    static constexpr ControlDecoder<CameraDevice, std::size(parameters)> decoder(parameters);
+
+    decoder.decode(this, value, m_packetCounters);
+
+    if (m_latency->waiting()) {
+        for (const Message &msg : Messages(value)) {
+            if (msg.destination==255)
+                m_latency->messageReceived(msg.category, msg.parameter);
+        }
+    }
 }
 
-void CameraDevice::confirmedDescriptorWrite(const QLowEnergyDescriptor &d, const QByteArray &value)
+
+/**
+ * @brief CameraDevice::writeBusy
+ * @return true while a command write is waiting for acknowledgement
+ */
+bool CameraDevice::writeBusy() const
 {
-    qDebug() << "confirmedDescriptorWrite" << d.name() << d.uuid() << value;
+    return m_queue->busy();
 }
 
 bool CameraDevice::isConnected() const
@@ -801,95 +919,101 @@ bool CameraDevice::isConnected() const
 
 bool CameraDevice::hasControllerError() const
 {
-    return (m_controller && m_controller->error() != QLowEnergyController::NoError);
+    return (m_transport && m_transport->hasError());
 }
 
-bool CameraDevice::writeCameraCommand(const QByteArray &cmd)
+bool CameraDevice::writeCameraCommand(const CutePocket::Command &cmd)
 {
-    if (!m_controller) {
-        qWarning("No controller!");
+    if (!m_transport) {
+        qCWarning(lcTx, "No transport!");
         return false;
     }
 
-    //if (controller->state()!=QLowEnergyController::DiscoveredState) {
-    //    qWarning() << "Not connected" << controller->state();
-    //    return false;
-    //}
-
-    if (!m_cameraService) {
-        qWarning("Camera service not available");
+    if (!m_transport->isReady()) {
+        qCWarning(lcTx, "Camera control not available");
         return false;
     }
 
-    if (!m_cameraOutgoing) {
-        qWarning("Camera descriptor not available");
+    if (!cmd.isValid()) {
+        qCWarning(lcTx, "Invalid command");
         return false;
     }
 
-    if (!m_cameraOutgoing->isValid())
-        qWarning("Camera descriptor is not valid ?");
+    // A relative change leaves the stored absolute value stale
+    const int slot=replaySlot(cmd);
+    if (slot>=0 && cmd.operation()==CutePocket::AssignOperation)
+        m_replay.insert(slot, cmd);
+    else if (slot>=0)
+        m_replay.remove(slot);
 
-    if (cmd.length()>64) {
-        qWarning("Command too large");
-        return false;
-    }
+    const bool unacknowledged=m_unacknowledgedWrites && m_transport->canWriteUnacknowledged() && isContinuous(cmd);
 
-    if (cmd.length() % 4 !=0 ) {
-        qWarning("Command must be aligned by 4 bytes");
+    if (!m_queue->enqueue(cmd, unacknowledged ? CameraTransport::UnacknowledgedWrite : CameraTransport::AcknowledgedWrite))
         return false;
-    }
 
-    qDebug() << "cmd" << cmd.toHex(':');
+    m_connectionPolicy->activity();
 
-    m_cameraService->writeCharacteristic(*m_cameraOutgoing, cmd);
+    // Triggers are never echoed back
+    if (cmd.type()!=CutePocket::VoidType)
+        m_latency->commandQueued(cmd.category(), cmd.parameter(), m_queue->pending());
 
     return true;
 }
 
-bool CameraDevice::writeCameraName(const QString &name)
+/**
+ * @brief CameraDevice::sendCameraCommand
+ * @param cmd
+ *
+ * @param mode
+ *
+ * Write a command released by the command queue to the camera.
+ */
+void CameraDevice::sendCameraCommand(const QByteArray &cmd, CameraTransport::WriteMode mode)
 {
-    if (!m_controller) {
-        qWarning("No controller!");
-        return false;
+    CutePocket::count(m_packetCounters.txPackets);
+    CutePocket::count(m_packetCounters.txBytes, cmd.size());
+
+    if (m_trace)
+        m_trace->record(CameraTrace::Tx, CameraTrace::Control, cmd);
+
+    // The link can not take this packet as a write command, send it acknowledged and have the queue wait for it
+    if (mode==CameraTransport::UnacknowledgedWrite && m_transport
+        && (!m_transport->canWriteUnacknowledged() || cmd.size()>m_transport->maximumWriteSize())) {
+        qCDebug(lcTx) << "Unacknowledged write not possible, sending acknowledged";
+        mode=CameraTransport::AcknowledgedWrite;
+        m_queue->writeStarted();
     }
 
-    if (!m_cameraService) {
-        qWarning("Camera service not available");
-        return false;
-    }
+    if (mode==CameraTransport::AcknowledgedWrite)
+        m_latency->writeStarted();
 
-    if (!m_cameraName) {
-        qWarning("Camera name descriptor not available");
+    if (!m_transport || !m_transport->writeControl(cmd, mode))
+        m_queue->clear();
+}
+
+bool CameraDevice::writeCameraName(const QString &name)
+{
+    if (!m_transport) {
+        qCWarning(lcTx, "No transport!");
         return false;
     }
 
-    if (!m_cameraName->isValid())
-        qWarning("Camera name descriptor is not valid ?");
-
     if (name.length()>32) {
-        qWarning("Name too long");
+        qCWarning(lcTx, "Name too long");
         return false;
     }
 
-    m_cameraService->writeCharacteristic(*m_cameraName, name.toLocal8Bit());
+    const QByteArray data=name.toLocal8Bit();
 
-    return true;
+    if (m_trace)
+        m_trace->record(CameraTrace::Tx, CameraTrace::Name, data);
+
+    return m_transport->writeName(data);
 }
 
 bool CameraDevice::autoFocus()
 {
-    QByteArray cmd(8, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x04; // Length
-    cmd[2]=0x00; // Command ID
-    cmd[3]=0x00; // Reserved = 0
-
-    cmd[4]=0x00; // Category
-    cmd[5]=0x01; // Param
-    cmd[6]=0x00; // Type
-    cmd[7]=0x00; // Operation
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(AutoFocusCommand::trigger());
 }
 
 bool CameraDevice::focus(qint16 focus, bool relative)
@@ -900,28 +1024,13 @@ bool CameraDevice::focus(qint16 focus, bool relative)
     // https://github.com/schoolpost/BlueMagic32/issues/5#issuecomment-731750648
     // https://forum.blackmagicdesign.com/viewtopic.php?f=12&t=139745&p=752492&hilit=relative+focus#p752492
     // https://forum.blackmagicdesign.com/viewtopic.php?f=12&t=119495&p=656983&hilit=relative+focus#p656983
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x08; // Length
-    cmd[4]=0x00; // Category
-    cmd[5]=0x00; // Param
-    cmd[6]=0x80;
-    cmd[7]=relative ? 0x01 : 0x00; // 0=Absolute MFT, 1=Relative EF
-    cmd[8]=focus & 0xff;
-    cmd[9]=(focus >> 8);
-    
-    return writeCameraCommand(cmd);
+    // 0=Absolute MFT, 1=Relative EF
+    return writeCameraCommand(relative ? FocusCommand::offset(focus) : FocusCommand::assign(focus));
 }
 
 bool CameraDevice::autoAperture()
 {
-    QByteArray cmd(8, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x04; // Length
-    cmd[4]=0x00; // Category
-    cmd[5]=0x05; // Param
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(AutoApertureCommand::trigger());
 }
 
 bool CameraDevice::zoom(double zoom)
@@ -929,42 +1038,18 @@ bool CameraDevice::zoom(double zoom)
     if (zoom < 0.0f && zoom > 1.0f)
         return false;
     
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x08; // Length
-    cmd[4]=0x00; // Category
-    cmd[5]=0x08; // Normalized zoom 0-1
-    cmd[6]=0x80;
-    cmd[7]=0x00;
-    
-    qint16 v=mapf(zoom, 0, 1.0, 0, 2047.0);
-    
-    cmd[8]=v & 0xff;
-    cmd[9]=(v >> 8);
-    
-    return writeCameraCommand(cmd);
+    // Normalized zoom 0-1
+    return writeCameraCommand(ZoomNormalizedCommand::assign(CutePocket::toFixed16(zoom)));
 }
 
 bool CameraDevice::autoWhitebalance()
 {
-    QByteArray cmd(8, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x04; // Length
-    cmd[4]=0x01; // Category
-    cmd[5]=0x03; // Param
-    
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(AutoWhiteBalanceCommand::trigger());
 }
 
 bool CameraDevice::restoreAutoWhiteBalance()
 {
-    QByteArray cmd(8, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x04; // Length
-    cmd[4]=0x01; // Category
-    cmd[5]=0x04; // Param
-    
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(RestoreAutoWhiteBalanceCommand::trigger());
 }
 
 bool CameraDevice::setShutterSpeed(qint32 shutter)
@@ -972,17 +1057,7 @@ bool CameraDevice::setShutterSpeed(qint32 shutter)
     if (shutter < 24 && shutter > 5000)
         return false;
 
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x08; // Length
-    cmd[4]=0x01; // Category
-    cmd[5]=0x0C; // Param
-    cmd[6]=0x02;
-
-    cmd[8]=shutter & 0xff;
-    cmd[9]=(shutter >> 8);
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(ShutterSpeedCommand::assign(shutter));
 }
 
 bool CameraDevice::setISO(qint32 is)
@@ -990,78 +1065,29 @@ bool CameraDevice::setISO(qint32 is)
     if (is < 100 && is > 25600)
         return false;
 
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x08; // Length
-    cmd[4]=0x01; // Category
-    cmd[5]=0x0E; // Param
-    cmd[6]=0x03;
-
-    cmd[8]=is & 0xff;
-    cmd[9]=(is >> 8);
-    cmd[10]=(is >> 16);
-    cmd[11]=(is >> 24);
-    
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(ISOCommand::assign(is));
 }
 
 bool CameraDevice::setAperture(double ap)
 {
-    double f;
-    
     if (ap < 1.0 && ap > 22.0)
         return false;
     
-    f=ap*ap;
-    f=log2(f);
-    
-    qDebug() << "AP" << ap << f;
+    const qint16 f=CutePocket::apertureToFixed16(ap);
     
-    quint16 m=float2fix(f);
+    qCPacket(lcTx) << "AP" << ap << f;
     
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x08; // Length
-    cmd[4]=0x00; // Category
-    cmd[5]=0x02; // Param
-    cmd[6]=0x80;
-    
-    cmd[8]=m & 0xff;
-    cmd[9]=(m >> 8);
-    
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(ApertureCommand::assign(f));
 }
 
 bool CameraDevice::setApertureNormalized(double ap)
 {
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x08; // Length
-    cmd[4]=0x00; // Category
-    cmd[5]=0x03; // Param
-    cmd[6]=0x02;
-    
-    quint16 m=float2fix(ap);
-    
-    cmd[8]=m & 0xff;
-    cmd[9]=(m >> 8);
-    
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(ApertureNormalizedCommand::assign(CutePocket::toFixed16(ap)));
 }
 
 bool CameraDevice::setApertureStep(quint16 apstep)
 {
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x08; // Length
-    cmd[4]=0x00; // Category
-    cmd[5]=0x04; // Param
-    cmd[6]=0x02;
-    
-    cmd[8]=apstep & 0xff;
-    cmd[9]=(apstep >> 8);
-    
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(ApertureOrdinalCommand::assign(static_cast<qint16>(apstep)));
 }
 
 bool CameraDevice::whiteBalance(qint16 wb, qint16 tint)
@@ -1072,179 +1098,91 @@ bool CameraDevice::whiteBalance(qint16 wb, qint16 tint)
     if (wb < 2500 && wb > 10000)
         return false;
     
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x08; // Length
-    cmd[4]=0x01; // Category
-    cmd[5]=0x02; // Param
-    cmd[6]=0x03;
-    
-    cmd[8]=wb & 0xff;
-    cmd[9]=(wb >> 8);
-    
-    cmd[10]=tint & 0xff;
-    cmd[11]=(tint >> 8);
-    
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(WhiteBalanceCommand::assign(wb, tint));
 }
 
 bool CameraDevice::setGain(qint8 gain)
 {
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x05; // Length
-    cmd[4]=0x01; // Category
-    cmd[5]=0x0D; // Param
-    cmd[6]=0x01;
-    cmd[8]=gain;
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(GainCommand::assign(gain));
 }
 
 bool CameraDevice::colorCorrectionReset()
 {
-    QByteArray cmd(8, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x04; // Length
-    cmd[4]=0x08; // Category
-    cmd[5]=0x07; // Param
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(ColorCorrectionResetCommand::trigger());
 }
 
 bool CameraDevice::captureStill()
 {
-    QByteArray cmd(8, 0);
-    cmd[0]=0xff; // Destination
-    cmd[1]=0x04; // Length
-    cmd[4]=0x0A; // Category
-    cmd[5]=0x03; // Param
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(CaptureCommand::trigger());
 }
 
 bool CameraDevice::record(bool record) {
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff;
-    cmd[1]=0x05;
-    cmd[4]=0x0A;
-    cmd[5]=0x01;
-    cmd[6]=0x01;
-    cmd[8]=record ? 2 : 0;
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(TransportModeCommand::assign(qint8(record ? 2 : 0)));
 }
 
 bool CameraDevice::play(bool play) {
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff;
-    cmd[1]=0x05;
-    cmd[4]=0x0A;
-    cmd[5]=0x01;
-    cmd[6]=0x01;
-    cmd[8]=play ? 1 : 0;
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(TransportModeCommand::assign(qint8(play ? 1 : 0)));
 }
 
 bool CameraDevice::playback(bool next) {
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff;
-    cmd[1]=0x05;
-    cmd[4]=0x0A;
-    cmd[5]=0x01;
-    cmd[6]=0x01;
-    cmd[8]=next ? 1 : 0;
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(TransportModeCommand::assign(qint8(next ? 1 : 0)));
 }
 
 bool CameraDevice::setColorbar(int sec) {
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff;
-    cmd[1]=0x05;
-    cmd[4]=0x04;
-    cmd[5]=0x04;
-    cmd[6]=0x01;
-    cmd[6]=0x02;
-    cmd[8]=qBound(0, sec, 30);
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(ColorBarsCommand::assign(qint8(qBound(0, sec, 30))));
 }
 
 /*
- * Time display (?) "ff:05:00:00:04:07:01:02:01"
- * Time display (?) "ff:05:00:00:04:07:01:02:00"
+ * Time display, captured as "ff:05:00:00:04:07:01:02:01" and "ff:05:00:00:04:07:01:02:00",
+ * the operation byte is 0x02 and not assign.
  * */
 bool CameraDevice::setDisplay(bool tc) {
-    QByteArray cmd(12, 0);
-    cmd[0]=0xff;
-    cmd[1]=0x05;
-    cmd[4]=0x04;
-    cmd[5]=0x07;
-    cmd[6]=0x01;
-    cmd[6]=0x02;
-    cmd[8]=tc ? 1 : 0;
-    
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(TimecodeDisplayCommand::build(DisplayOperation, qint8(tc ? 1 : 0)));
 }
 
 /**
  * @brief CameraDevice::colorControl
- * @param c
  * @param r
  * @param g
  * @param b
  * @param l
  * @return
  */
-bool CameraDevice::colorControl(uint8_t c, double r, double g, double b, double l) {
-    int16_t ir,ig,ib,il;
-
-    QByteArray cmd(16, 0);
-    cmd[0]=0xff;
-    cmd[1]=0x0C;
-    cmd[4]=0x08;
-    cmd[5]=c;
-    cmd[6]=0x80;
-    cmd[7]=0x00;
-
-    ir=float2fix(r);
-    ig=float2fix(g);
-    ib=float2fix(b);
-    il=float2fix(l);
+template<quint8 Parameter>
+bool CameraDevice::colorControl(double r, double g, double b, double l) {
+    const CutePocket::Fixed16x4 v=CutePocket::toFixed16x4({ float(r), float(g), float(b), float(l) });
 
-    qDebug() << ir << ig << ib << il;
+    qCPacket(lcTx) << v[0] << v[1] << v[2] << v[3];
 
-    cmd[8]=ir & 0xff;
-    cmd[9]=(ir >> 8);
-
-    cmd[10]=ig & 0xff;
-    cmd[11]=(ig >> 8);
-
-    cmd[12]=ib & 0xff;
-    cmd[13]=(ib >> 8);
-
-    cmd[14]=il & 0xff;
-    cmd[15]=(il >> 8);
-
-    return writeCameraCommand(cmd);
+    return writeCameraCommand(ColorCorrectionCommand<Parameter>::assign(v[0], v[1], v[2], v[3]));
 }
 
 bool CameraDevice::colorLift(double r, double g, double b, double l) {
-    return colorControl(0, r, g, b, l);
+    return colorControl<0>(r, g, b, l);
 }
 
 bool CameraDevice::colorGamma(double r, double g, double b, double l) {
-    return colorControl(1, r, g, b, l);
+    return colorControl<1>(r, g, b, l);
 }
 
 bool CameraDevice::colorGain(double r, double g, double b, double l) {
-    return colorControl(2, r, g, b, l);
+    return colorControl<2>(r, g, b, l);
 }
 
 bool CameraDevice::colorOffset(double r, double g, double b, double l) {
-    return colorControl(3, r, g, b, l);
+    return colorControl<3>(r, g, b, l);
+}
+
+bool CameraDevice::colorContrast(double pivot, double adjust) {
+    return writeCameraCommand(ContrastCommand::assign(CutePocket::toFixed16(pivot), CutePocket::toFixed16(adjust)));
+}
+
+bool CameraDevice::colorLumaMix(double mix) {
+    return writeCameraCommand(LumaMixCommand::assign(CutePocket::toFixed16(mix)));
+}
+
+bool CameraDevice::colorAdjust(double hue, double saturation) {
+    return writeCameraCommand(ColorAdjustCommand::assign(CutePocket::toFixed16(hue), CutePocket::toFixed16(saturation)));
 }
 
 bool CameraDevice::recording() const
@@ -1252,7 +1190,7 @@ bool CameraDevice::recording() const
     return m_recording;
 }
 
-QTime CameraDevice::timecode() const
+TimecodeModel *CameraDevice::timecode() const
 {
     return m_timecode;
 }
@@ -3,18 +3,29 @@
 
 #include <QtCore>
 
-#include <QBluetoothDeviceDiscoveryAgent>
 #include <QBluetoothDeviceInfo>
-#include <QLowEnergyController>
-#include <QBluetoothUuid>
 
 #include <QtQmlIntegration/qqmlintegration.h>
 
+#include "timecodemodel.h"
+#include "cameracommand.h"
+#include "colorcorrection.h"
+#include "latencystats.h"
+#include "cameratransport.h"
+#include "connectionpolicy.h"
+#include "cameralogging.h"
+
 QT_BEGIN_NAMESPACE
 class QBluetoothDeviceInfo;
-class QBluetoothUuid;
 QT_END_NAMESPACE
 
+class CameraCommandQueue;
+class CameraTrace;
+
+namespace CutePocket {
+struct Message;
+}
+
 class CameraDevice: public QObject
 {
     Q_OBJECT
@@ -25,9 +36,16 @@ class CameraDevice: public QObject
     Q_PROPERTY(bool playing READ playing NOTIFY playingChanged FINAL)
 
     Q_PROPERTY(bool connected READ isConnected NOTIFY connectedChanged FINAL)
+    Q_PROPERTY(ConnectionState connectionState READ connectionState NOTIFY connectionStateChanged FINAL)
+    Q_PROPERTY(bool autoReconnect READ autoReconnect WRITE setAutoReconnect NOTIFY autoReconnectChanged FINAL)
+    Q_PROPERTY(bool unacknowledgedWrites READ unacknowledgedWrites WRITE setUnacknowledgedWrites NOTIFY unacknowledgedWritesChanged FINAL)
+    Q_PROPERTY(int maximumWriteSize READ maximumWriteSize NOTIFY maximumWriteSizeChanged FINAL)
+    Q_PROPERTY(bool replayState READ replayState WRITE setReplayState NOTIFY replayStateChanged FINAL)
 
     Q_PROPERTY(QString name READ name NOTIFY nameChanged FINAL)
 
+    Q_PROPERTY(bool tracing READ tracing NOTIFY tracingChanged FINAL)
+
     Q_PROPERTY(int status READ status NOTIFY statusChanged FINAL)
 
     Q_PROPERTY(int wb READ wb NOTIFY wbChanged FINAL)
@@ -41,7 +59,12 @@ class CameraDevice: public QObject
 
     Q_PROPERTY(int zoom READ zoom NOTIFY zoomChanged FINAL)
 
-    Q_PROPERTY(QTime timecode READ timecode NOTIFY timecodeChanged FINAL)
+    Q_PROPERTY(int frameRate READ frameRate NOTIFY frameRateChanged FINAL)
+
+    Q_PROPERTY(TimecodeModel *timecode READ timecode CONSTANT FINAL)
+    Q_PROPERTY(ColorCorrection *colorCorrection READ colorCorrection CONSTANT FINAL)
+    Q_PROPERTY(LatencyStats *latency READ latency CONSTANT FINAL)
+    Q_PROPERTY(ConnectionPolicy *connectionPolicy READ connectionPolicy CONSTANT FINAL)
     Q_PROPERTY(bool timecodeDisplay READ timecodeDisplay NOTIFY timecodeDisplayChanged FINAL)
     
     Q_PROPERTY(qint8 metaTakeNumber READ metaTakeNumber NOTIFY metaTakeNumberChanged FINAL)
@@ -69,20 +92,50 @@ class CameraDevice: public QObject
     Q_PROPERTY(QString metaSlateTarget READ metaSlateTarget NOTIFY metaSlateTargetChanged FINAL)
     
     QML_ELEMENT
-    QML_SINGLETON
 
 public:
     CameraDevice();
     ~CameraDevice();
 
+    enum ConnectionState {
+        Disconnected,
+        Connecting,
+        Connected,
+        Ready,
+        Reconnecting
+    };
+    Q_ENUM(ConnectionState)
+
     bool isConnected() const;
 
+    ConnectionState connectionState() const { return m_connectionState; }
+
+    bool autoReconnect() const { return m_autoReconnect; }
+
+    // Disconnected on request, stays so until connected again
+    bool userDisconnected() const { return m_userDisconnect; }
+    void setAutoReconnect(bool autoReconnect);
+
+    bool unacknowledgedWrites() const { return m_unacknowledgedWrites; }
+    void setUnacknowledgedWrites(bool unacknowledged);
+
+    int maximumWriteSize() const;
+
+    bool replayState() const { return m_replayState; }
+    void setReplayState(bool replay);
+
     bool discovering();
     bool hasControllerError() const;
 
     bool recording() const;
 
-    QTime timecode() const;
+    TimecodeModel *timecode() const;
+
+    ColorCorrection *colorCorrection() const { return m_colorCorrection; }
+
+    LatencyStats *latency() const { return m_latency; }
+
+    ConnectionPolicy *connectionPolicy() const { return m_connectionPolicy; }
 
     int status() const;
 
@@ -92,6 +145,8 @@ public:
 
     QString name() const;
 
+    QString address() const { return m_address; }
+
     int zoom() const;
 
     double apterture() const;
@@ -103,6 +158,14 @@ public:
     int shutterSpeed() const;
     
     bool timecodeDisplay() const;
+
+    int frameRate() const { return m_frameRate; }
+    qint64 timecodeFrames() const;
+
+    bool writeBusy() const;
+
+    Q_INVOKABLE QVariantMap notifyStats() const;
+    Q_INVOKABLE void resetNotifyStats();
     
     qint8 metaTakeNumber() const { return m_meta_take_number; }
     
@@ -128,12 +191,25 @@ public:
     
     QString metaSlateTarget() const { return m_meta_slate_target; }
         
+    bool tracing() const;
+
+    void setTransport(CameraTransport *transport);
+    CameraTransport *transport() const { return m_transport; }
+
 public slots:
-    void connectDevice(QBluetoothDeviceInfo *device);
+    void connectDevice(const QBluetoothDeviceInfo &device);
+    void connectSimulator();
+    void connectReplay(const QString &file, double speed=1.0);
     void disconnectFromDevice();
 
     bool setCameraName(const QString name);
 
+    bool startTrace(const QString &file=QString());
+    void stopTrace();
+
+    void beginBatch();
+    void commitBatch();
+
     bool autoFocus();
     bool autoAperture();
 
@@ -163,27 +239,27 @@ public slots:
     bool colorGamma(double r, double g, double b, double l);
     bool colorGain(double r, double g, double b, double l);
     bool colorOffset(double r, double g, double b, double l);
+    bool colorContrast(double pivot, double adjust);
+    bool colorLumaMix(double mix);
+    bool colorAdjust(double hue, double saturation);
 
     bool setColorbar(int sec);
     bool setDisplay(bool tc);
     
 private slots:
-    void scanServices(const QString &address);
-    void scanServices(const QBluetoothDeviceInfo &device);
-    
-    void connectToService(const QString &uuid);
-
-    void addLowEnergyService(const QBluetoothUuid &uuid);
     void deviceConnected();
-    void errorReceived(QLowEnergyController::Error);
-    void serviceScanDone();
+    void deviceReady();
     void deviceDisconnected();
+    void deviceConnectionFailure();
 
-    void serviceDetailsDiscovered(QLowEnergyService::ServiceState newState);
+    void reconnect();
 
-    void characteristicChanged(QLowEnergyCharacteristic characteristic, QByteArray value);
-    void serviceStateChanged(QLowEnergyService::ServiceState s);
-    void confirmedDescriptorWrite(const QLowEnergyDescriptor &d, const QByteArray &value);
+    void handleControlData(const QByteArray &value);
+    void handleTimecodeData(const QByteArray &value);
+    void handleCameraStatus(const QByteArray &value);
+
+    void sendCameraCommand(const QByteArray &cmd, CameraTransport::WriteMode mode);
+    void updateWriteSize();
 
 Q_SIGNALS:
     void devicesUpdated();
@@ -194,8 +270,13 @@ Q_SIGNALS:
     void controllerErrorChanged();
 
     void connectedChanged();
+    void tracingChanged();
+    void connectionStateChanged();
+    void autoReconnectChanged();
+    void unacknowledgedWritesChanged();
+    void maximumWriteSizeChanged();
+    void replayStateChanged();
     void recordingChanged();
-    void timecodeChanged();
     void statusChanged();
 
     void wbChanged();
@@ -216,6 +297,13 @@ Q_SIGNALS:
     void shutterSpeedChanged();
     
     void timecodeDisplayChanged();
+
+    void frameRateChanged();
+
+    void writeIdle();
+
+    // Every transport mode message from the camera, changed or not
+    void transportModeReceived();
     
     void metaTakeNumberChanged();
     
@@ -244,44 +332,80 @@ Q_SIGNALS:
     void metaSlateTargetChanged();
     
 protected:
-    void handleLensData(const QByteArray &data);
-    void handleVideoData(const QByteArray &data);
-    void handleAudioData(const QByteArray &data);
-    void handleOutputData(const QByteArray &data);
-    void handleMediaData(const QByteArray &data);
-    void handleDisplayData(const QByteArray &data);
-    void handleTallyData(const QByteArray &data);
-    void handleReferenceData(const QByteArray &data);
-    void handleConfigData(const QByteArray &data);
-    void handleColorData(const QByteArray &data);
-    void handleStatusData(const QByteArray &data);    
-    void handleMetaData(const QByteArray &data);
-
-    bool colorControl(uint8_t c, double r, double g, double b, double l);
+    template<auto Notify>
+    void notify(bool changed);
+
+    template<auto Field, auto Notify, typename V>
+    bool updateField(const V &value);
+
+    template<auto Field, auto Notify>
+    void decodeField(const CutePocket::Message &msg);
+
+    void handleAutoFocus(const CutePocket::Message &msg);
+    void handleAperture(const CutePocket::Message &msg);
+    void handleWhiteBalance(const CutePocket::Message &msg);
+    void handleOverlays(const CutePocket::Message &msg);
+    void handleCodec(const CutePocket::Message &msg);
+    void handleRecordingFormat(const CutePocket::Message &msg);
+    void handleTransportMode(const CutePocket::Message &msg);
+    void handleTake(const CutePocket::Message &msg);
+    void handleColorCorrection(const CutePocket::Message &msg);
+
+    template<quint8 Parameter>
+    bool colorControl(double r, double g, double b, double l);
 private:
-    bool writeCameraCommand(const QByteArray &cmd);
+    bool writeCameraCommand(const CutePocket::Command &cmd);
     bool writeCameraName(const QString &name);
 
-    QBluetoothDeviceInfo *m_currentDevice=nullptr;
+    void loadCachedState();
+    void saveCachedState();
+
+    void setConnectionState(ConnectionState state);
+    void scheduleReconnect();
+    void replayCommands();
+
+    struct NotifyCounter {
+        quint32 emitted = 0;
+        quint32 suppressed = 0;
+    };
 
-    QHash<QString, QBluetoothDeviceInfo *> m_cameras;
+    // Indexed by notify signal method index
+    QList<NotifyCounter> m_notifyCounters;
 
-    QList<QLowEnergyService *> m_services;
-    QHash<QBluetoothUuid, QLowEnergyService *> m_servicess;
+    CutePocket::PacketCounters m_packetCounters;
 
     bool m_connected = false;
 
-    QLowEnergyController *m_controller = nullptr;
-    QLowEnergyService *m_cameraService = nullptr;
-    QLowEnergyCharacteristic *m_cameraOutgoing = nullptr;
-    QLowEnergyCharacteristic *m_cameraName = nullptr;
+    ConnectionState m_connectionState = Disconnected;
+    bool m_autoReconnect = true;
+    bool m_unacknowledgedWrites = false;
+    bool m_replayState = true;
+    bool m_userDisconnect = false;
+    bool m_replayPending = false;
+    int m_reconnectAttempts = 0;
+    QTimer m_reconnectTimer;
+    QTimer m_connectTimer;
+
+    // Device to reconnect to
+    QBluetoothDeviceInfo m_device;
+
+    // Last commanded exposure, white balance and lens values, replayed after a reconnect
+    QHash<quint16, CutePocket::Command> m_replay;
+
+    CameraTransport *m_transport = nullptr;
+    CameraCommandQueue *m_queue = nullptr;
+    CameraTrace *m_trace = nullptr;
     
     bool m_discovering = false;
 
     // Camera state
     QString m_name;
+    QString m_address;
     qint8 m_status = 0;
-    QTime m_timecode;
+    TimecodeModel *m_timecode;
+    ColorCorrection *m_colorCorrection;
+    LatencyStats *m_latency;
+    ConnectionPolicy *m_connectionPolicy;
     bool m_recording = false;
     bool m_playing = false;
     qint8 m_gain = 0;
@@ -297,6 +421,8 @@ private:
     
     bool m_timecodeDisplay=false;
 
+    qint16 m_frameRate=0;
+
     quint8 m_codec=0;
     quint8 m_codec_variant=0;
     quint8 m_media_speed=0;
@@ -313,7 +439,7 @@ private:
     qint8 m_meta_location;
     qint8 m_meta_day;
     QString m_meta_scene;
-    qint8 m_meta_take_number;
+    qint8 m_meta_take_number = 0;
     qint8 m_meta_take_tags;
     QString m_meta_camera_id;
     QString m_meta_camera_operator;
@@ -1,45 +1,100 @@
 #include "cameradiscovery.h"
+#include "cameralogging.h"
+#include "cameratransport.h"
+
+#include <QSettings>
 
 static const QBluetoothUuid BmdCameraService("291D567A-6D75-11E6-8B77-86F30CA893D3");
 
+// Remove cameras not seen in this many scans in a row
+static const int MaxMissedScans = 2;
+
+// One-shot scan length
+static const int ScanTimeout = 5000;
+
+// Continuous mode scans for ScanWindow out of every ScanInterval, a 10% duty cycle
+static const int ScanWindow = 2000;
+static const int ScanInterval = 20000;
+
 CameraDiscovery::CameraDiscovery(QObject *parent)
-    : QObject{parent}
+    : QAbstractListModel{parent}
 {
+    m_clock.start();
+
     m_discoveryAgent = new QBluetoothDeviceDiscoveryAgent(this);
-    m_discoveryAgent->setLowEnergyDiscoveryTimeout(5000);
-    
+    m_discoveryAgent->setLowEnergyDiscoveryTimeout(ScanTimeout);
+
     connect(m_discoveryAgent, &QBluetoothDeviceDiscoveryAgent::deviceDiscovered, this, &CameraDiscovery::addCameraDevice);
     connect(m_discoveryAgent, &QBluetoothDeviceDiscoveryAgent::deviceUpdated, this, &CameraDiscovery::addCameraDevice);
     connect(m_discoveryAgent, &QBluetoothDeviceDiscoveryAgent::errorOccurred, this, &CameraDiscovery::deviceScanError);
     connect(m_discoveryAgent, &QBluetoothDeviceDiscoveryAgent::finished, this, &CameraDiscovery::deviceScanFinished);
     connect(m_discoveryAgent, &QBluetoothDeviceDiscoveryAgent::canceled, this, &CameraDiscovery::deviceScanFinished);
+
+    m_scanTimer.setInterval(ScanInterval);
+    connect(&m_scanTimer, &QTimer::timeout, this, &CameraDiscovery::startDeviceDiscovery);
+
+    QSettings settings;
+    m_known=settings.value("discovery/known").toStringList();
 }
 
 CameraDiscovery::~CameraDiscovery()
 {
-    clearDevices();
+
+}
+
+int CameraDiscovery::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return m_devices.size();
 }
 
-void CameraDiscovery::clearDevices()
+QVariant CameraDiscovery::data(const QModelIndex &index, int role) const
 {
-    m_cameras.clear();
-    
-    qDeleteAll(m_devices);
-    m_devices.clear();
-    
-    emit countChanged();
-    emit devicesUpdated();
+    if (!index.isValid() || index.row()>=m_devices.size())
+        return QVariant();
+
+    const Camera &c=m_devices.at(index.row());
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case NameRole:
+        return c.info.name();
+    case AddressRole:
+        return c.address;
+    case RssiRole:
+        return c.info.rssi();
+    case CachedRole:
+        return c.info.isCached();
+    case LastSeenRole:
+        return c.seenAt;
+    }
+
+    return QVariant();
+}
+
+QHash<int, QByteArray> CameraDiscovery::roleNames() const
+{
+    return {
+        { NameRole, "name" },
+        { AddressRole, "address" },
+        { RssiRole, "rssi" },
+        { CachedRole, "cached" },
+        { LastSeenRole, "lastSeen" }
+    };
 }
 
 void CameraDiscovery::startDeviceDiscovery()
 {
-    clearDevices();
-    
     if (m_discoveryAgent->isActive())
         return;
-    
+
+    m_scanStarted=m_clock.elapsed();
+
+    m_discoveryAgent->setLowEnergyDiscoveryTimeout(m_continuous ? ScanWindow : ScanTimeout);
     m_discoveryAgent->start(QBluetoothDeviceDiscoveryAgent::LowEnergyMethod);
-    
+
     if (m_discoveryAgent->isActive()) {
         m_discovering = true;
         emit discoveringChanged();
@@ -53,6 +108,29 @@ void CameraDiscovery::stopDeviceDiscovery()
         m_discoveryAgent->stop();
 }
 
+/**
+ * @brief CameraDiscovery::setContinuous
+ * @param continuous
+ *
+ * Scan in the background with a low duty cycle, starting right away.
+ */
+void CameraDiscovery::setContinuous(bool continuous)
+{
+    if (m_continuous==continuous)
+        return;
+
+    m_continuous=continuous;
+
+    if (m_continuous) {
+        m_scanTimer.start();
+        startDeviceDiscovery();
+    } else {
+        m_scanTimer.stop();
+    }
+
+    emit continuousChanged();
+}
+
 bool CameraDiscovery::discovering()
 {
     return m_discovering;
@@ -60,10 +138,12 @@ bool CameraDiscovery::discovering()
 
 void CameraDiscovery::deviceScanError(QBluetoothDeviceDiscoveryAgent::Error error)
 {
+    qCWarning(lcDiscovery) << "Scan failed" << error << m_discoveryAgent->errorString();
+
     emit controllerErrorChanged();
-    
+
     m_discovering = false;
-    
+
     emit discoveringChanged();
 }
 
@@ -72,40 +152,93 @@ void CameraDiscovery::deviceScanError(QBluetoothDeviceDiscoveryAgent::Error erro
  * @param info
  *
  * Store found BLE device if it is a BM Camera, by first checking if the CameraService is available.
- * If not, ignore the BLE device.
+ * If not, ignore the BLE device. Known cameras are updated in place.
  *
  */
 void CameraDiscovery::addCameraDevice(const QBluetoothDeviceInfo &info)
-{       
+{
     // BMPCC is BLE only so ignore anything else
     if (info.coreConfigurations()!=QBluetoothDeviceInfo::LowEnergyCoreConfiguration)
         return;
-    
+
     // Check if device has BM service 291d567a-6d75-11e6-8b77-86f30ca893d3 ?
     auto uuids=info.serviceUuids();
     if (!uuids.contains(BmdCameraService)) {
         return;
     }
-    
-    qDebug() << "Found BM camera service!";
-    qDebug() << info.address() << info.name() << info.rssi() << info.isCached();
-    
-// #ifndef Q_OS_WIN32
-//     if (info.rssi()==0) {
-//         qDebug("Ignoring off-line device");
-//         return;
-//     }
-// #endif
-    
-    QBluetoothDeviceInfo *device=new QBluetoothDeviceInfo(info);
-    if (m_devices.contains(info.address().toString())) {
-        QBluetoothDeviceInfo *tmp=m_devices.take(info.address().toString());
-        delete tmp;
+
+    const QString address=CameraTransport::deviceAddress(info);
+    const int i=indexOf(address);
+
+    if (i<0) {
+        qCDebug(lcDiscovery) << "Found BM camera service!";
+        qCDebug(lcDiscovery) << info.address() << info.name() << info.rssi() << info.isCached();
+
+        beginInsertRows(QModelIndex(), m_devices.size(), m_devices.size());
+        m_devices.append({ info, address, m_clock.elapsed(), QDateTime::currentDateTime(), 0 });
+        endInsertRows();
+
+        emit countChanged();
+
+        if (m_known.contains(address))
+            emit knownCameraSeen(info);
+        return;
+    }
+
+    Camera &c=m_devices[i];
+    const bool firstThisScan=c.lastSeen<m_scanStarted;
+    QList<int> roles;
+
+    if (c.info.name()!=info.name())
+        roles << Qt::DisplayRole << NameRole;
+    if (c.info.rssi()!=info.rssi())
+        roles << RssiRole;
+    if (c.info.isCached()!=info.isCached())
+        roles << CachedRole;
+
+    c.info=info;
+    c.lastSeen=m_clock.elapsed();
+    c.seenAt=QDateTime::currentDateTime();
+    c.missedScans=0;
+
+    // Advertisements repeat constantly, the last seen time is updated in the view once per scan
+    if (!roles.isEmpty()) {
+        const QModelIndex idx=index(i);
+        emit dataChanged(idx, idx, roles);
+    }
+
+    if (firstThisScan && m_known.contains(address))
+        emit knownCameraSeen(info);
+}
+
+/**
+ * @brief CameraDiscovery::ageDevices
+ *
+ * Drop cameras that were not seen in the last MaxMissedScans scans, report the new
+ * last seen time of the ones that were.
+ */
+void CameraDiscovery::ageDevices()
+{
+    for (int i=m_devices.size()-1; i>=0; i--) {
+        Camera &c=m_devices[i];
+
+        if (c.lastSeen>=m_scanStarted) {
+            const QModelIndex idx=index(i);
+            emit dataChanged(idx, idx, { LastSeenRole });
+            continue;
+        }
+
+        if (++c.missedScans<MaxMissedScans)
+            continue;
+
+        qCDebug(lcDiscovery) << "Camera gone" << c.address << c.info.name();
+
+        beginRemoveRows(QModelIndex(), i, i);
+        m_devices.removeAt(i);
+        endRemoveRows();
+
+        emit countChanged();
     }
-    m_devices.insert(info.address().toString(), device);
-    
-    emit countChanged();
-    emit devicesUpdated();
 }
 
 /**
@@ -116,38 +249,66 @@ void CameraDiscovery::addCameraDevice(const QBluetoothDeviceInfo &info)
 void CameraDiscovery::deviceScanFinished()
 {
     m_discovering = false;
-    
-    QBluetoothDeviceInfo *info;
-    foreach (info, m_devices) {
-        QVariantMap dev;
-        
-        dev.insert("address", info->address().toString());
-        dev.insert("name", info->name());
-        dev.insert("rssi", info->rssi());
-        
-        m_cameras.append(dev);
-    }
-    
+
+    ageDevices();
+
     emit discoveringChanged();
-    emit discoveryStop(m_cameras.count());
+    emit discoveryStop(m_devices.count());
 }
 
 QString CameraDiscovery::getDefaultDevice()
 {
-    if (!m_cameras.isEmpty()) {
-        return "";
+    if (!m_devices.isEmpty()) {
+        return m_devices.first().address;
     }
     return "";
 }
 
-QBluetoothDeviceInfo *CameraDiscovery::getBluetoothDevice(QString address)
+int CameraDiscovery::indexOf(const QString &address) const
 {
-    return m_devices.value(address);
+    for (int i=0; i<m_devices.size(); i++) {
+        if (m_devices.at(i).address==address)
+            return i;
+    }
+
+    return -1;
 }
 
-QVariantList CameraDiscovery::getDevices()
+QBluetoothDeviceInfo CameraDiscovery::getBluetoothDevice(const QString &address) const
 {
-    return m_cameras;
+    const int i=indexOf(address);
+
+    return i<0 ? QBluetoothDeviceInfo() : m_devices.at(i).info;
+}
+
+void CameraDiscovery::addKnownCamera(const QString &address)
+{
+    if (address.isEmpty() || m_known.contains(address))
+        return;
+
+    m_known.append(address);
+    saveKnownCameras();
+}
+
+void CameraDiscovery::removeKnownCamera(const QString &address)
+{
+    if (!m_known.removeOne(address))
+        return;
+
+    saveKnownCameras();
+}
+
+bool CameraDiscovery::isKnownCamera(const QString &address) const
+{
+    return m_known.contains(address);
+}
+
+void CameraDiscovery::saveKnownCameras()
+{
+    QSettings settings;
+    settings.setValue("discovery/known", m_known);
+
+    emit knownCamerasChanged();
 }
 
 int CameraDiscovery::count() const
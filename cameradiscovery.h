@@ -1,54 +1,113 @@
 #ifndef CAMERADISCOVERY_H
 #define CAMERADISCOVERY_H
 
-#include <QObject>
+#include <QAbstractListModel>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QQmlEngine>
+#include <QTimer>
 
 #include <QBluetoothDeviceDiscoveryAgent>
 #include <QBluetoothDeviceInfo>
 
-class CameraDiscovery : public QObject
+/**
+ * @brief The CameraDiscovery class
+ *
+ * Found cameras keyed by address. Entries are added as soon as they are seen and
+ * updated in place, cameras that are missing from several scans in a row are aged out.
+ * The last seen time is the wall clock time of the last advertisement, updated in the
+ * view once per scan.
+ *
+ * In continuous mode short scan windows are repeated in the background, previously
+ * connected (known) cameras are reported with knownCameraSeen() as soon as they advertise.
+ */
+class CameraDiscovery : public QAbstractListModel
 {
     Q_OBJECT
     Q_PROPERTY(bool discovering READ discovering NOTIFY discoveringChanged FINAL)
     Q_PROPERTY(int count READ count NOTIFY countChanged FINAL)
+    Q_PROPERTY(bool continuous READ continuous WRITE setContinuous NOTIFY continuousChanged FINAL)
+    Q_PROPERTY(QStringList knownCameras READ knownCameras NOTIFY knownCamerasChanged FINAL)
     QML_ELEMENT
     QML_SINGLETON
 public:
     explicit CameraDiscovery(QObject *parent = nullptr);
-    
+
     ~CameraDiscovery();
+
+    enum Roles {
+        NameRole = Qt::UserRole + 1,
+        AddressRole,
+        RssiRole,
+        CachedRole,
+        LastSeenRole
+    };
+    Q_ENUM(Roles)
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
     int count() const;
-    
+
+    bool continuous() const { return m_continuous; }
+    void setContinuous(bool continuous);
+
+    QStringList knownCameras() const { return m_known; }
+
 public slots:
     void stopDeviceDiscovery();
     void startDeviceDiscovery();
-    QVariantList getDevices();
     QString getDefaultDevice();
-    QBluetoothDeviceInfo *getBluetoothDevice(QString address);
-    
+    QBluetoothDeviceInfo getBluetoothDevice(const QString &address) const;
+    int indexOf(const QString &address) const;
+
+    void addKnownCamera(const QString &address);
+    void removeKnownCamera(const QString &address);
+    bool isKnownCamera(const QString &address) const;
+
 signals:
     void discoveryStart();
     void discoveryStop(qsizetype devices);
-    void devicesUpdated();
     void discoveringChanged();
     void controllerErrorChanged();
-    
+
     void countChanged();
-    
+    void continuousChanged();
+    void knownCamerasChanged();
+
+    // A previously connected camera is advertising
+    void knownCameraSeen(const QBluetoothDeviceInfo &device);
+
 protected:
     bool discovering();
 private slots:
     void addCameraDevice(const QBluetoothDeviceInfo&);
     void deviceScanFinished();
     void deviceScanError(QBluetoothDeviceDiscoveryAgent::Error);
-    
+
 private:
+    struct Camera {
+        QBluetoothDeviceInfo info;
+        QString address;
+        qint64 lastSeen;
+        QDateTime seenAt;
+        int missedScans;
+    };
+
+    void ageDevices();
+    void saveKnownCameras();
+
     QBluetoothDeviceDiscoveryAgent *m_discoveryAgent;
-    QVariantList m_cameras;
-    QMap<QString, QBluetoothDeviceInfo *> m_devices;
+    QList<Camera> m_devices;
+    QElapsedTimer m_clock;
+    qint64 m_scanStarted=0;
     bool m_discovering=false;
-    void clearDevices();
+
+    bool m_continuous=false;
+    QTimer m_scanTimer;
+
+    QStringList m_known;
 };
 
 #endif // CAMERADISCOVERY_H
@@ -0,0 +1,32 @@
+#include "cameralogging.h"
+
+Q_LOGGING_CATEGORY(lcDiscovery, "cutepocket.discovery")
+Q_LOGGING_CATEGORY(lcGatt, "cutepocket.gatt")
+
+// Packet level categories are verbose, debug output is opt-in with QT_LOGGING_RULES
+Q_LOGGING_CATEGORY(lcRx, "cutepocket.rx", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcTx, "cutepocket.tx", QtInfoMsg)
+
+namespace CutePocket
+{
+
+void PacketCounters::reset()
+{
+    for (std::atomic<quint64> *c : { &rxPackets, &rxBytes, &rxMessages, &rxErrors, &timecodes, &txPackets, &txBytes })
+        c->store(0, std::memory_order_relaxed);
+}
+
+void logPacketCounters(const PacketCounters &counters)
+{
+    const auto load=[](const std::atomic<quint64> &c) { return c.load(std::memory_order_relaxed); };
+
+    qCInfo(lcRx) << "Received" << load(counters.rxPackets) << "packets"
+                 << load(counters.rxBytes) << "bytes"
+                 << load(counters.rxMessages) << "messages"
+                 << load(counters.rxErrors) << "errors"
+                 << load(counters.timecodes) << "timecodes";
+    qCInfo(lcTx) << "Sent" << load(counters.txPackets) << "packets"
+                 << load(counters.txBytes) << "bytes";
+}
+
+}
@@ -0,0 +1,54 @@
+#ifndef CAMERALOGGING_H
+#define CAMERALOGGING_H
+
+#include <QLoggingCategory>
+
+#include <atomic>
+
+Q_DECLARE_LOGGING_CATEGORY(lcDiscovery)
+Q_DECLARE_LOGGING_CATEGORY(lcGatt)
+Q_DECLARE_LOGGING_CATEGORY(lcRx)
+Q_DECLARE_LOGGING_CATEGORY(lcTx)
+
+/*
+ * Per-packet protocol tracing. Only compiled in with the CUTEPOCKET_PACKET_TRACE
+ * build option, otherwise the statement and its arguments are never evaluated.
+ */
+#ifdef CUTEPOCKET_PACKET_TRACE
+#define qCPacket(category) qCDebug(category)
+#else
+#define qCPacket(category) QT_NO_QDEBUG_MACRO()
+#endif
+
+namespace CutePocket
+{
+
+/**
+ * @brief The PacketCounters struct
+ *
+ * Protocol event counters of one camera connection, always available and cheap
+ * enough for the hot paths.
+ */
+struct PacketCounters
+{
+    void reset();
+
+    std::atomic<quint64> rxPackets{0};
+    std::atomic<quint64> rxBytes{0};
+    std::atomic<quint64> rxMessages{0};
+    std::atomic<quint64> rxErrors{0};
+    std::atomic<quint64> timecodes{0};
+    std::atomic<quint64> txPackets{0};
+    std::atomic<quint64> txBytes{0};
+};
+
+inline void count(std::atomic<quint64> &counter, quint64 value = 1)
+{
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+void logPacketCounters(const PacketCounters &counters);
+
+}
+
+#endif // CAMERALOGGING_H
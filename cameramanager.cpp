@@ -0,0 +1,419 @@
+#include "cameramanager.h"
+#include "cameralogging.h"
+#include "cameratransport.h"
+
+#include <QUrl>
+
+// Simulated and replayed cameras are never advertised
+static bool isVirtualCamera(const QString &address)
+{
+    return address.startsWith("simulator-") || address.startsWith("replay-");
+}
+
+CameraManager::CameraManager(QObject *parent)
+    : QAbstractListModel{parent}
+{
+    m_placeholder=new CameraDevice();
+    m_placeholder->setParent(this);
+
+    m_sync=new RecordSync(this);
+}
+
+CameraManager::~CameraManager()
+{
+    for (const Camera &c : std::as_const(m_cameras))
+        c.device->disconnect(this);
+}
+
+int CameraManager::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return m_cameras.size();
+}
+
+QVariant CameraManager::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row()>=m_cameras.size())
+        return QVariant();
+
+    const Camera &c=m_cameras.at(index.row());
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case NameRole:
+        return c.device->name().isEmpty() ? c.address : c.device->name();
+    case CameraRole:
+        return QVariant::fromValue(c.device);
+    case AddressRole:
+        return c.address;
+    case ConnectedRole:
+        return c.device->isConnected();
+    case RecordingRole:
+        return c.device->recording();
+    case GroupRole:
+        return c.grouped;
+    }
+
+    return QVariant();
+}
+
+bool CameraManager::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || index.row()>=m_cameras.size() || role!=GroupRole)
+        return false;
+
+    setGrouped(index.row(), value.toBool());
+
+    return true;
+}
+
+QHash<int, QByteArray> CameraManager::roleNames() const
+{
+    return {
+        { CameraRole, "camera" },
+        { NameRole, "name" },
+        { AddressRole, "address" },
+        { ConnectedRole, "connected" },
+        { RecordingRole, "recording" },
+        { GroupRole, "grouped" }
+    };
+}
+
+int CameraManager::count() const
+{
+    return m_cameras.size();
+}
+
+CameraDevice *CameraManager::current() const
+{
+    if (m_current<0)
+        return m_placeholder;
+
+    return m_cameras.at(m_current).device;
+}
+
+int CameraManager::currentIndex() const
+{
+    return m_current;
+}
+
+void CameraManager::setCurrentIndex(int index)
+{
+    if (index<-1 || index>=m_cameras.size() || index==m_current)
+        return;
+
+    m_current=index;
+    emit currentChanged();
+}
+
+bool CameraManager::recording() const
+{
+    for (const Camera &c : m_cameras) {
+        if (c.device->recording())
+            return true;
+    }
+
+    return false;
+}
+
+int CameraManager::indexOf(const QString &address) const
+{
+    for (int i=0; i<m_cameras.size(); i++) {
+        if (m_cameras.at(i).address==address)
+            return i;
+    }
+
+    return -1;
+}
+
+int CameraManager::indexOf(const CameraDevice *device) const
+{
+    for (int i=0; i<m_cameras.size(); i++) {
+        if (m_cameras.at(i).device==device)
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief CameraManager::addressOf
+ * @param device
+ * @return key the camera was added with, empty if the device is not managed
+ */
+QString CameraManager::addressOf(const CameraDevice *device) const
+{
+    const int i=indexOf(device);
+
+    return i<0 ? QString() : m_cameras.at(i).address;
+}
+
+CameraDevice *CameraManager::camera(int index) const
+{
+    if (index<0 || index>=m_cameras.size())
+        return nullptr;
+
+    return m_cameras.at(index).device;
+}
+
+CameraDevice *CameraManager::cameraByAddress(const QString &address) const
+{
+    return camera(indexOf(address));
+}
+
+/**
+ * @brief CameraManager::addCamera
+ * @param address
+ * @return camera for the address, a new one is created if needed
+ */
+CameraDevice *CameraManager::addCamera(const QString &address)
+{
+    const int i=indexOf(address);
+    if (i>=0)
+        return m_cameras.at(i).device;
+
+    CameraDevice *device=new CameraDevice();
+    device->setParent(this);
+
+    connect(device, &CameraDevice::nameChanged, this, [this, device]() {
+        cameraChanged(device, { Qt::DisplayRole, NameRole });
+    });
+    connect(device, &CameraDevice::connectedChanged, this, [this, device, address]() {
+        cameraChanged(device, { ConnectedRole });
+
+        if (device->isConnected() && m_discovery && !isVirtualCamera(address))
+            m_discovery->addKnownCamera(address);
+    });
+    connect(device, &CameraDevice::recordingChanged, this, [this, device]() {
+        cameraChanged(device, { RecordingRole });
+        emit recordingChanged();
+    });
+
+    beginInsertRows(QModelIndex(), m_cameras.size(), m_cameras.size());
+    m_cameras.append({ address, device, true });
+    endInsertRows();
+
+    emit countChanged();
+
+    return device;
+}
+
+void CameraManager::cameraChanged(CameraDevice *device, const QList<int> &roles)
+{
+    for (int i=0; i<m_cameras.size(); i++) {
+        if (m_cameras.at(i).device==device) {
+            const QModelIndex idx=index(i);
+            emit dataChanged(idx, idx, roles);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief CameraManager::connectCamera
+ * @param device
+ * @return the camera connecting to the device, it is made the current camera
+ */
+CameraDevice *CameraManager::connectCamera(const QBluetoothDeviceInfo &device)
+{
+    if (!device.isValid())
+        return nullptr;
+
+    const QString address=CameraTransport::deviceAddress(device);
+
+    m_userDisconnected.remove(address);
+
+    CameraDevice *camera=connectAddress(address, device);
+
+    setCurrentIndex(indexOf(address));
+
+    return camera;
+}
+
+CameraDevice *CameraManager::connectAddress(const QString &address, const QBluetoothDeviceInfo &device)
+{
+    CameraDevice *camera=addCamera(address);
+
+    // Already connected or (re)connecting
+    if (camera->connectionState()==CameraDevice::Disconnected)
+        camera->connectDevice(device);
+
+    return camera;
+}
+
+/**
+ * @brief CameraManager::knownCameraSeen
+ * @param device
+ *
+ * A previously connected camera is advertising, connect to it right away. Cameras the
+ * user disconnected or removed are left alone until they are connected again.
+ */
+void CameraManager::knownCameraSeen(const QBluetoothDeviceInfo &device)
+{
+    if (!m_autoConnect)
+        return;
+
+    const QString address=CameraTransport::deviceAddress(device);
+
+    if (m_userDisconnected.contains(address))
+        return;
+
+    const CameraDevice *camera=cameraByAddress(address);
+    if (camera && camera->userDisconnected())
+        return;
+
+    qCDebug(lcDiscovery) << "Known camera seen, connecting" << address;
+
+    connectAddress(address, device);
+
+    if (m_current<0)
+        setCurrentIndex(indexOf(address));
+}
+
+void CameraManager::setDiscovery(CameraDiscovery *discovery)
+{
+    if (m_discovery==discovery)
+        return;
+
+    if (m_discovery)
+        m_discovery->disconnect(this);
+
+    m_discovery=discovery;
+
+    if (m_discovery)
+        connect(m_discovery, &CameraDiscovery::knownCameraSeen, this, &CameraManager::knownCameraSeen);
+
+    emit discoveryChanged();
+}
+
+void CameraManager::setAutoConnect(bool autoConnect)
+{
+    if (m_autoConnect==autoConnect)
+        return;
+
+    m_autoConnect=autoConnect;
+    emit autoConnectChanged();
+}
+
+CameraDevice *CameraManager::connectSimulator()
+{
+    const QString address=QStringLiteral("simulator-%1").arg(++m_simulators);
+
+    CameraDevice *camera=addCamera(address);
+    camera->connectSimulator();
+
+    setCurrentIndex(indexOf(address));
+
+    return camera;
+}
+
+/**
+ * @brief CameraManager::connectReplay
+ * @param file trace file path or local file URL
+ * @param speed playback speed multiplier, 0 for as fast as possible
+ * @return camera playing back the trace
+ */
+CameraDevice *CameraManager::connectReplay(const QString &file, double speed)
+{
+    const QUrl url(file);
+    const QString path=url.isLocalFile() ? url.toLocalFile() : file;
+    const QString address=QStringLiteral("replay-%1").arg(++m_replays);
+
+    CameraDevice *camera=addCamera(address);
+    camera->connectReplay(path, speed);
+
+    setCurrentIndex(indexOf(address));
+
+    return camera;
+}
+
+void CameraManager::removeCamera(int index)
+{
+    if (index<0 || index>=m_cameras.size())
+        return;
+
+    CameraDevice *device=m_cameras.at(index).device;
+
+    m_userDisconnected.insert(m_cameras.at(index).address);
+
+    device->disconnect(this);
+    device->disconnectFromDevice();
+
+    beginRemoveRows(QModelIndex(), index, index);
+    m_cameras.removeAt(index);
+    endRemoveRows();
+
+    device->deleteLater();
+
+    if (m_current==index) {
+        m_current=m_cameras.isEmpty() ? -1 : 0;
+        emit currentChanged();
+    } else if (m_current>index) {
+        m_current--;
+        emit currentChanged();
+    }
+
+    emit countChanged();
+    emit recordingChanged();
+}
+
+void CameraManager::disconnectAll()
+{
+    for (const Camera &c : std::as_const(m_cameras)) {
+        m_userDisconnected.insert(c.address);
+        c.device->disconnectFromDevice();
+    }
+}
+
+void CameraManager::setGrouped(int index, bool grouped)
+{
+    if (index<0 || index>=m_cameras.size() || m_cameras.at(index).grouped==grouped)
+        return;
+
+    m_cameras[index].grouped=grouped;
+
+    const QModelIndex idx=this->index(index);
+    emit dataChanged(idx, idx, { GroupRole });
+}
+
+/**
+ * @brief CameraManager::record
+ * @param record
+ * @return number of cameras the command was staged on
+ *
+ * Synchronized record start/stop of the group, see RecordSync.
+ */
+int CameraManager::record(bool record)
+{
+    QList<CameraDevice *> group;
+
+    for (const Camera &c : std::as_const(m_cameras)) {
+        if (c.grouped)
+            group.append(c.device);
+    }
+
+    return m_sync->trigger(group, record);
+}
+
+int CameraManager::setISO(qint32 iso)
+{
+    return broadcast([iso](CameraDevice *device) {
+        return device->setISO(iso);
+    });
+}
+
+int CameraManager::setShutterSpeed(qint32 shutter)
+{
+    return broadcast([shutter](CameraDevice *device) {
+        return device->setShutterSpeed(shutter);
+    });
+}
+
+int CameraManager::whiteBalance(qint16 wb, qint16 tint)
+{
+    return broadcast([wb, tint](CameraDevice *device) {
+        return device->whiteBalance(wb, tint);
+    });
+}
@@ -0,0 +1,160 @@
+#ifndef CAMERAMANAGER_H
+#define CAMERAMANAGER_H
+
+#include <QAbstractListModel>
+#include <QBluetoothDeviceInfo>
+#include <QList>
+#include <QPointer>
+#include <QSet>
+#include <QQmlEngine>
+
+#include "cameradevice.h"
+#include "cameradiscovery.h"
+#include "recordsync.h"
+
+/**
+ * @brief The CameraManager class
+ *
+ * Owns one CameraDevice per camera address and exposes them as a list model.
+ * Commands can be broadcast to the group of cameras, the writes to each camera
+ * are released together instead of one camera after another.
+ *
+ * With a discovery attached, known cameras are connected as soon as they are seen
+ * and cameras that connect are remembered as known.
+ */
+class CameraManager : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged FINAL)
+    Q_PROPERTY(CameraDevice *current READ current NOTIFY currentChanged FINAL)
+    Q_PROPERTY(int currentIndex READ currentIndex WRITE setCurrentIndex NOTIFY currentChanged FINAL)
+    Q_PROPERTY(bool recording READ recording NOTIFY recordingChanged FINAL)
+    Q_PROPERTY(RecordSync *sync READ sync CONSTANT FINAL)
+    Q_PROPERTY(CameraDiscovery *discovery READ discovery WRITE setDiscovery NOTIFY discoveryChanged FINAL)
+    Q_PROPERTY(bool autoConnect READ autoConnect WRITE setAutoConnect NOTIFY autoConnectChanged FINAL)
+    QML_ELEMENT
+
+public:
+    explicit CameraManager(QObject *parent = nullptr);
+    ~CameraManager();
+
+    enum Roles {
+        CameraRole = Qt::UserRole + 1,
+        NameRole,
+        AddressRole,
+        ConnectedRole,
+        RecordingRole,
+        GroupRole
+    };
+    Q_ENUM(Roles)
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const;
+
+    CameraDevice *current() const;
+    int currentIndex() const;
+    void setCurrentIndex(int index);
+
+    bool recording() const;
+
+    RecordSync *sync() const { return m_sync; }
+
+    CameraDiscovery *discovery() const { return m_discovery; }
+    void setDiscovery(CameraDiscovery *discovery);
+
+    bool autoConnect() const { return m_autoConnect; }
+    void setAutoConnect(bool autoConnect);
+
+    /**
+     * Call func for every connected camera in the group. All camera queues are
+     * held while func runs and released back to back afterwards.
+     */
+    template<typename F>
+    int broadcast(F func);
+
+public slots:
+    CameraDevice *connectCamera(const QBluetoothDeviceInfo &device);
+    CameraDevice *connectSimulator();
+    CameraDevice *connectReplay(const QString &file, double speed=1.0);
+    void removeCamera(int index);
+    void disconnectAll();
+
+    CameraDevice *camera(int index) const;
+    CameraDevice *cameraByAddress(const QString &address) const;
+    int indexOf(const QString &address) const;
+    int indexOf(const CameraDevice *device) const;
+    QString addressOf(const CameraDevice *device) const;
+
+    void setGrouped(int index, bool grouped);
+
+    int record(bool record);
+    int setISO(qint32 iso);
+    int setShutterSpeed(qint32 shutter);
+    int whiteBalance(qint16 wb, qint16 tint);
+
+signals:
+    void countChanged();
+    void currentChanged();
+    void recordingChanged();
+    void discoveryChanged();
+    void autoConnectChanged();
+
+private:
+    struct Camera {
+        QString address;
+        CameraDevice *device;
+        bool grouped;
+    };
+
+    CameraDevice *addCamera(const QString &address);
+    CameraDevice *connectAddress(const QString &address, const QBluetoothDeviceInfo &device);
+    void knownCameraSeen(const QBluetoothDeviceInfo &device);
+    void cameraChanged(CameraDevice *device, const QList<int> &roles);
+
+    QList<Camera> m_cameras;
+    int m_current=-1;
+    int m_simulators=0;
+    int m_replays=0;
+
+    // Shown to the UI until a camera has been added
+    CameraDevice *m_placeholder;
+
+    RecordSync *m_sync;
+
+    QPointer<CameraDiscovery> m_discovery;
+    bool m_autoConnect=true;
+
+    // Removed or disconnected by the user, not auto connected until connected again explicitly
+    QSet<QString> m_userDisconnected;
+};
+
+template<typename F>
+int CameraManager::broadcast(F func)
+{
+    QList<CameraDevice *> group;
+
+    for (const Camera &c : std::as_const(m_cameras)) {
+        if (c.grouped && c.device->isConnected())
+            group.append(c.device);
+    }
+
+    for (CameraDevice *device : std::as_const(group))
+        device->beginBatch();
+
+    int written=0;
+    for (CameraDevice *device : std::as_const(group)) {
+        if (func(device))
+            written++;
+    }
+
+    for (CameraDevice *device : std::as_const(group))
+        device->commitBatch();
+
+    return written;
+}
+
+#endif // CAMERAMANAGER_H
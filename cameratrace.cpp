@@ -0,0 +1,272 @@
+#include "cameratrace.h"
+#include "cameralogging.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QtEndian>
+
+#include <cstring>
+
+static const char TraceMagic[4] = { 'C', 'P', 'T', 'R' };
+static const quint16 TraceVersion = 1;
+
+static const int HeaderSize = 64;
+static const int RecordHeaderSize = 16;
+static const quint32 WrapMarker = 0xffffffff;
+
+// Header field offsets
+static const int HeaderVersion = 4;
+static const int HeaderSizeField = 6;
+static const int HeaderCapacity = 8;
+static const int HeaderHead = 16;
+static const int HeaderTail = 24;
+static const int HeaderCount = 32;
+static const int HeaderStartTime = 40;
+
+static quint32 align4(quint32 v) { return (v + 3) & ~3u; }
+
+CameraTrace::CameraTrace(QObject *parent)
+    : QObject{parent}
+{
+
+}
+
+CameraTrace::~CameraTrace()
+{
+    close();
+}
+
+/**
+ * @brief CameraTrace::open
+ * @param path
+ * @param capacity ring size in bytes
+ * @return true if the trace file was created and mapped
+ */
+bool CameraTrace::open(const QString &path, quint32 capacity)
+{
+    close();
+
+    capacity=align4(qMax<quint32>(capacity, 4096));
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        qCWarning(lcGatt) << "Failed to open trace file" << path << m_file.errorString();
+        return false;
+    }
+
+    if (!m_file.resize(HeaderSize+capacity)) {
+        qCWarning(lcGatt) << "Failed to size trace file" << path << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    m_map=m_file.map(0, HeaderSize+capacity);
+    if (!m_map) {
+        qCWarning(lcGatt) << "Failed to map trace file" << path << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    m_ring=m_map+HeaderSize;
+    m_capacity=capacity;
+
+    memset(m_map, 0, HeaderSize);
+    memcpy(m_map, TraceMagic, sizeof(TraceMagic));
+    qToLittleEndian<quint16>(TraceVersion, m_map+HeaderVersion);
+    qToLittleEndian<quint16>(HeaderSize, m_map+HeaderSizeField);
+    qToLittleEndian<quint32>(capacity, m_map+HeaderCapacity);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), m_map+HeaderStartTime);
+
+    m_clock.start();
+
+    return true;
+}
+
+void CameraTrace::close()
+{
+    if (!m_map)
+        return;
+
+    m_file.unmap(m_map);
+    m_file.close();
+
+    m_map=nullptr;
+    m_ring=nullptr;
+    m_capacity=0;
+}
+
+quint32 CameraTrace::readLength(quint64 offset) const
+{
+    return qFromLittleEndian<quint32>(m_ring+offset);
+}
+
+/**
+ * @brief CameraTrace::advanceTail
+ *
+ * Drop the oldest record.
+ */
+void CameraTrace::advanceTail()
+{
+    quint64 tail=qFromLittleEndian<quint64>(m_map+HeaderTail);
+    quint64 count=qFromLittleEndian<quint64>(m_map+HeaderCount);
+
+    const quint32 length=readLength(tail);
+
+    if (length==WrapMarker) {
+        tail=0;
+    } else {
+        tail+=RecordHeaderSize+align4(length);
+        if (tail>=m_capacity)
+            tail=0;
+        count--;
+    }
+
+    qToLittleEndian<quint64>(tail, m_map+HeaderTail);
+    qToLittleEndian<quint64>(count, m_map+HeaderCount);
+}
+
+/**
+ * @brief CameraTrace::evict
+ *
+ * Drop records until the ring region [from, to) can be overwritten.
+ */
+void CameraTrace::evict(quint64 from, quint64 to)
+{
+    for (;;) {
+        const quint64 tail=qFromLittleEndian<quint64>(m_map+HeaderTail);
+        const quint64 count=qFromLittleEndian<quint64>(m_map+HeaderCount);
+
+        if (count==0 || tail<from || tail>=to)
+            return;
+
+        advanceTail();
+    }
+}
+
+/**
+ * @brief CameraTrace::record
+ * @param direction
+ * @param channel
+ * @param payload
+ * @return true if the record was stored
+ */
+bool CameraTrace::record(Direction direction, Channel channel, QByteArrayView payload)
+{
+    if (!m_map)
+        return false;
+
+    const quint32 size=RecordHeaderSize+align4(payload.size());
+    if (size>m_capacity/2)
+        return false;
+
+    quint64 head=qFromLittleEndian<quint64>(m_map+HeaderHead);
+
+    if (head+size>m_capacity) {
+        evict(head, m_capacity);
+        qToLittleEndian<quint32>(WrapMarker, m_ring+head);
+        head=0;
+    }
+
+    evict(head, head+size);
+
+    quint64 count=qFromLittleEndian<quint64>(m_map+HeaderCount);
+    if (count==0)
+        qToLittleEndian<quint64>(head, m_map+HeaderTail);
+
+    uchar *r=m_ring+head;
+    qToLittleEndian<quint32>(payload.size(), r);
+    r[4]=direction;
+    r[5]=channel;
+    qToLittleEndian<quint16>(0, r+6);
+    qToLittleEndian<qint64>(m_clock.nsecsElapsed(), r+8);
+    memcpy(r+RecordHeaderSize, payload.data(), payload.size());
+
+    head+=size;
+    if (head>=m_capacity)
+        head=0;
+
+    qToLittleEndian<quint64>(head, m_map+HeaderHead);
+    qToLittleEndian<quint64>(count+1, m_map+HeaderCount);
+
+    return true;
+}
+
+/**
+ * @brief CameraTrace::load
+ * @param path
+ * @param startTime wall clock start time of the trace in ms since epoch
+ * @return all records in the trace, oldest first
+ */
+QList<CameraTrace::Record> CameraTrace::load(const QString &path, qint64 *startTime)
+{
+    QList<Record> records;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(lcGatt) << "Failed to open trace file" << path << file.errorString();
+        return records;
+    }
+
+    const QByteArray data=file.readAll();
+    const uchar *d=reinterpret_cast<const uchar *>(data.constData());
+
+    if (data.size()<HeaderSize || memcmp(d, TraceMagic, sizeof(TraceMagic))!=0) {
+        qCWarning(lcGatt) << "Not a trace file" << path;
+        return records;
+    }
+
+    const quint16 version=qFromLittleEndian<quint16>(d+HeaderVersion);
+    const quint16 headerSize=qFromLittleEndian<quint16>(d+HeaderSizeField);
+    const quint32 capacity=qFromLittleEndian<quint32>(d+HeaderCapacity);
+
+    if (version!=TraceVersion || data.size()<qint64(headerSize)+capacity) {
+        qCWarning(lcGatt) << "Unsupported trace file" << path << version;
+        return records;
+    }
+
+    if (startTime)
+        *startTime=qFromLittleEndian<qint64>(d+HeaderStartTime);
+
+    const uchar *ring=d+headerSize;
+    quint64 offset=qFromLittleEndian<quint64>(d+HeaderTail);
+    quint64 count=qFromLittleEndian<quint64>(d+HeaderCount);
+
+    // Every record takes at least a record header in the ring, do not trust a larger count
+    if (count>capacity/RecordHeaderSize) {
+        qCWarning(lcGatt) << "Corrupt trace file" << path << "record count" << count;
+        return records;
+    }
+
+    records.reserve(count);
+
+    while (count>0 && offset+4<=capacity) {
+        const quint32 length=qFromLittleEndian<quint32>(ring+offset);
+
+        if (length==WrapMarker) {
+            if (offset==0)
+                break;
+            offset=0;
+            continue;
+        }
+
+        if (offset+RecordHeaderSize+length>capacity) {
+            qCWarning(lcGatt) << "Corrupt trace record at" << offset;
+            break;
+        }
+
+        const uchar *r=ring+offset;
+        Record rec;
+        rec.direction=static_cast<Direction>(r[4]);
+        rec.channel=static_cast<Channel>(r[5]);
+        rec.timestamp=qFromLittleEndian<qint64>(r+8);
+        rec.payload=QByteArray(reinterpret_cast<const char *>(r+RecordHeaderSize), length);
+        records.append(rec);
+
+        offset+=RecordHeaderSize+align4(length);
+        if (offset>=capacity)
+            offset=0;
+        count--;
+    }
+
+    return records;
+}
@@ -0,0 +1,76 @@
+#ifndef CAMERATRACE_H
+#define CAMERATRACE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+
+/**
+ * @brief The CameraTrace class
+ *
+ * Binary protocol trace recorder. Records are written into a ring buffer in a
+ * memory mapped file, when the ring is full the oldest records are dropped.
+ *
+ * File layout, all fields little-endian:
+ *   header, HeaderSize bytes: magic "CPTR", version, capacity, head, tail, record count, start time
+ *   ring, capacity bytes: records of RecordHeaderSize bytes + payload padded to 4 bytes
+ *
+ * A record header is length (u32), direction (u8), channel (u8), reserved (u16) and
+ * timestamp in ns since the trace was started (i64). A length of WrapMarker means the
+ * next record is at the start of the ring.
+ */
+class CameraTrace : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CameraTrace(QObject *parent = nullptr);
+    ~CameraTrace();
+
+    enum Direction : quint8 {
+        Rx = 0,
+        Tx = 1
+    };
+
+    // Camera characteristic the payload belongs to
+    enum Channel : quint8 {
+        Control = 0,
+        Timecode = 1,
+        Status = 2,
+        Name = 3
+    };
+
+    struct Record {
+        qint64 timestamp;
+        Direction direction;
+        Channel channel;
+        QByteArray payload;
+    };
+
+    static const quint32 DefaultCapacity = 4*1024*1024;
+
+    bool open(const QString &path, quint32 capacity = DefaultCapacity);
+    void close();
+    bool isOpen() const { return m_map!=nullptr; }
+
+    QString fileName() const { return m_file.fileName(); }
+
+    bool record(Direction direction, Channel channel, QByteArrayView payload);
+
+    static QList<Record> load(const QString &path, qint64 *startTime = nullptr);
+
+private:
+    quint32 readLength(quint64 offset) const;
+    void advanceTail();
+    void evict(quint64 from, quint64 to);
+
+    QFile m_file;
+    uchar *m_map=nullptr;
+    uchar *m_ring=nullptr;
+    quint32 m_capacity=0;
+    QElapsedTimer m_clock;
+};
+
+#endif // CAMERATRACE_H
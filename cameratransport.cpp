@@ -0,0 +1,56 @@
+#include "cameratransport.h"
+
+CameraTransport::CameraTransport(QObject *parent)
+    : QObject{parent}
+{
+
+}
+
+/**
+ * @brief CameraTransport::deviceAddress
+ * @param device
+ * @return address identifying the camera, the device UUID without braces on platforms that hide the address
+ */
+QString CameraTransport::deviceAddress(const QBluetoothDeviceInfo &device)
+{
+    // macOS/iOS do not expose the address, only a device UUID
+    if (device.address().isNull())
+        return device.deviceUuid().toString(QUuid::WithoutBraces);
+
+    return device.address().toString();
+}
+
+bool CameraTransport::hasError() const
+{
+    return false;
+}
+
+/**
+ * @brief CameraTransport::canWriteUnacknowledged
+ * @return true if writeControl() supports UnacknowledgedWrite
+ */
+bool CameraTransport::canWriteUnacknowledged() const
+{
+    return false;
+}
+
+/**
+ * @brief CameraTransport::maximumWriteSize
+ * @return 64, the camera control packet limit, for transports without a smaller link limit
+ */
+int CameraTransport::maximumWriteSize() const
+{
+    return 64;
+}
+
+/**
+ * @brief CameraTransport::requestConnectionProfile
+ * @param profile
+ * @return true if the request was made
+ */
+bool CameraTransport::requestConnectionProfile(ConnectionProfile profile)
+{
+    Q_UNUSED(profile)
+
+    return false;
+}
@@ -0,0 +1,79 @@
+#ifndef CAMERATRANSPORT_H
+#define CAMERATRANSPORT_H
+
+#include <QObject>
+#include <QByteArray>
+
+#include <QBluetoothDeviceInfo>
+
+/**
+ * @brief The CameraTransport class
+ *
+ * Link between CameraDevice and a camera. Carries outgoing camera control
+ * packets and delivers incoming control, timecode and status notifications.
+ */
+class CameraTransport : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CameraTransport(QObject *parent = nullptr);
+
+    static QString deviceAddress(const QBluetoothDeviceInfo &device);
+
+    enum WriteMode {
+        // Completion is signalled with controlWritten()
+        AcknowledgedWrite,
+        // No completion signal, the caller paces the writes
+        UnacknowledgedWrite
+    };
+
+    enum ConnectionProfile {
+        // Long connection interval, low power
+        IdleConnection,
+        // Short connection interval, low command latency
+        ActiveConnection
+    };
+
+    virtual void connectToDevice(const QBluetoothDeviceInfo &device) = 0;
+    virtual void disconnectFromDevice() = 0;
+
+    // Outgoing camera control can be written
+    virtual bool isReady() const = 0;
+
+    virtual bool writeControl(const QByteArray &data, WriteMode mode) = 0;
+    virtual bool writeName(const QByteArray &name) = 0;
+
+    virtual QString name() const = 0;
+    virtual QString address() const = 0;
+
+    virtual bool hasError() const;
+
+    virtual bool canWriteUnacknowledged() const;
+
+    // Largest control write that goes out as a single packet on the link
+    virtual int maximumWriteSize() const;
+
+    // Connection parameters are reported with connectionParametersChanged() once negotiated
+    virtual bool requestConnectionProfile(ConnectionProfile profile);
+
+signals:
+    void connected();
+    void ready();
+    void disconnected();
+    void connectionFailure();
+    void errorChanged();
+
+    void controlReceived(const QByteArray &data);
+    void timecodeReceived(const QByteArray &data);
+    void statusReceived(const QByteArray &data);
+
+    void controlWritten();
+    void controlWriteFailed();
+
+    void maximumWriteSizeChanged();
+
+    // Interval and supervision timeout in ms, latency in connection events
+    void connectionParametersChanged(double interval, int latency, int supervisionTimeout);
+};
+
+#endif // CAMERATRANSPORT_H
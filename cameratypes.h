@@ -2,103 +2,167 @@
 #define CAMERATYPES_H
 
 #include <QObject>
+#include <QByteArrayView>
+#include <QString>
+
+#include "camerawire.h"
+#include "fixedpoint.h"
 
 namespace CutePocket
 {
 Q_NAMESPACE
 
-typedef union
-{
-    quint16 u16;
-    quint8 u8[2];
-} U16_U8;
-
-typedef union
-{
-    qint16 s16;
-    qint8 u8[2];
-} S16_S8;
-
-typedef union
-{
-    quint32 u32;
-    quint16 u16[2];
-    quint8 u8[4];
-} U32_U8;
-
-typedef union
-{
-    qint32 s32;
-    quint8 u8[4];
-} S32_U8;
-
-typedef union
+enum DataType
 {
-    qint32 s32;
-    qint8 s8[4];
-} S32_S8;
-
-typedef union
-{
-    qint64 s64;
-    qint8  s8[8];
-} S64_S8;
-
-inline quint16 uint16at(const QByteArray &ba, int p) {
-    CutePocket::U16_U8 val;
-    val.u8[0] = static_cast<quint8>(ba.at(p));
-    val.u8[1] = static_cast<quint8>(ba.at(p+1));
-    
-    return val.u16;
+    VoidType = 0x00,
+    Int8Type = 0x01,
+    Int16Type = 0x02,
+    Int32Type = 0x03,
+    Int64Type = 0x04,
+    StringType = 0x05,
+    Fixed16Type = 0x80
 };
-
-inline qint16 int16at(const QByteArray &ba, int p) {
-    CutePocket::S16_S8 val;
-    val.u8[0] = static_cast<qint8>(ba.at(p));
-    val.u8[1] = static_cast<qint8>(ba.at(p+1));
-    
-    return val.s16;
+Q_ENUM_NS(DataType)
+
+constexpr int dataTypeSize(quint8 type) {
+    switch (type) {
+    case Int8Type:
+    case StringType:
+        return 1;
+    case Int16Type:
+    case Fixed16Type:
+        return 2;
+    case Int32Type:
+        return 4;
+    case Int64Type:
+        return 8;
+    default:
+        return 0;
+    }
 };
 
-inline quint32 uint32at(const QByteArray &ba, int p) {
-    CutePocket::U32_U8 val;
-    val.u8[3] = static_cast<quint8>(ba.at(p));
-    val.u8[2] = static_cast<quint8>(ba.at(p+1));
-    val.u8[1] = static_cast<quint8>(ba.at(p+2));
-    val.u8[0] = static_cast<quint8>(ba.at(p+3));
-    
-    return val.u32;
-};
+// Size of the packet header (destination, length, id, reserved) and command header (category, parameter, type, operation)
+constexpr int MessageHeaderSize = 8;
 
-inline qint32 int32at(const QByteArray &ba, int p) {
-    CutePocket::S32_U8 val;
-    val.u8[0] = static_cast<quint8>(ba.at(p));
-    val.u8[1] = static_cast<quint8>(ba.at(p+1));
-    val.u8[2] = static_cast<quint8>(ba.at(p+2));
-    val.u8[3] = static_cast<quint8>(ba.at(p+3));
-    
-    return val.s32;
-};
-
-inline qint64 int64at(const QByteArray &ba, int p) {
-    CutePocket::S64_S8 val;
-    val.s8[7] = static_cast<qint8>(ba.at(p));
-    val.s8[6] = static_cast<qint8>(ba.at(p+1));
-    val.s8[5] = static_cast<qint8>(ba.at(p+2));
-    val.s8[4] = static_cast<qint8>(ba.at(p+3));
-    val.s8[3] = static_cast<qint8>(ba.at(p+4));
-    val.s8[2] = static_cast<qint8>(ba.at(p+5));
-    val.s8[1] = static_cast<qint8>(ba.at(p+6));
-    val.s8[0] = static_cast<qint8>(ba.at(p+7));
-    
-    return val.s64;
+/**
+ * @brief The Message struct
+ *
+ * One camera control message, the payload refers to the received packet.
+ */
+struct Message
+{
+    quint8 destination;
+    quint8 category;
+    quint8 parameter;
+    quint8 type;
+    quint8 operation;
+    QByteArrayView payload;
+
+    // Little endian element at index, 0 if out of range
+    qint64 integer(qsizetype index=0) const {
+        const int size=dataTypeSize(type);
+
+        if (size==0 || index<0)
+            return 0;
+
+        return Wire::loadSigned(Wire::bytes(payload), index*size, size);
+    }
+
+    // Fixed16 element at index
+    double fixed(qsizetype index=0) const {
+        return fromFixed16(static_cast<qint16>(integer(index)));
+    }
+
+    QString string() const {
+        qsizetype n=payload.size();
+        while (n>0 && payload.at(n-1)=='\0')
+            n--;
+        return QString::fromUtf8(payload.first(n));
+    }
 };
 
-inline bool boolat(const QByteArray &ba, int p) {
-    return static_cast<bool>(ba.at(p));
+/**
+ * @brief The Messages class
+ *
+ * Iterates all 4-byte aligned messages of a camera control packet without copying,
+ * iteration stops at the first message that does not fit in the packet. Leftover bytes
+ * too short for a message header and an empty packet also count as truncated.
+ */
+class Messages
+{
+public:
+    class Iterator
+    {
+    public:
+        Iterator(const Messages *messages, qsizetype pos) : m_messages(messages), m_pos(pos) { parse(); }
+
+        const Message &operator*() const { return m_msg; }
+        const Message *operator->() const { return &m_msg; }
+
+        Iterator &operator++() {
+            m_pos=m_next;
+            parse();
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const { return m_pos==other.m_pos; }
+        bool operator!=(const Iterator &other) const { return m_pos!=other.m_pos; }
+
+    private:
+        void parse() {
+            const QByteArrayView data=m_messages->m_data;
+            const Wire::Bytes bytes=Wire::bytes(data);
+
+            if (m_pos+MessageHeaderSize>data.size()) {
+                if (m_pos<data.size() || data.isEmpty())
+                    m_messages->m_truncated=true;
+                m_pos=data.size();
+                return;
+            }
+
+            // Destination, length, id, reserved and category, parameter, type, operation
+            const quint32 packet=Wire::load<quint32>(bytes, m_pos);
+            const quint32 command=Wire::load<quint32>(bytes, m_pos+4);
+
+            const quint8 length=packet >> 8;
+            if (length<4 || m_pos+4+length>data.size()) {
+                m_messages->m_truncated=true;
+                m_pos=data.size();
+                return;
+            }
+
+            m_msg={
+                static_cast<quint8>(packet),
+                static_cast<quint8>(command),
+                static_cast<quint8>(command >> 8),
+                static_cast<quint8>(command >> 16),
+                static_cast<quint8>(command >> 24),
+                data.sliced(m_pos+MessageHeaderSize, length-4)
+            };
+
+            // Messages are padded to 4 bytes
+            m_next=qMin(m_pos+((4+length+3) & ~3), data.size());
+        }
+
+        const Messages *m_messages;
+        qsizetype m_pos;
+        qsizetype m_next=0;
+        Message m_msg {};
+    };
+
+    explicit Messages(QByteArrayView data) : m_data(data) {}
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, m_data.size()); }
+
+    // The packet did not end on a complete message, valid after iterating
+    bool truncated() const { return m_truncated; }
+
+private:
+    QByteArrayView m_data;
+    mutable bool m_truncated=false;
 };
 
-
 enum MediaType
 {
     StillMedia = 1,
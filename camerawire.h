@@ -0,0 +1,141 @@
+#ifndef CAMERAWIRE_H
+#define CAMERAWIRE_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace CutePocket::Wire
+{
+
+/*
+ * Little-endian wire codec. The values are assembled from bytes with shifts so the
+ * result does not depend on host byte order, compilers fold the expressions into single
+ * loads and stores on little-endian targets.
+ */
+
+using Bytes = std::span<const std::byte>;
+using MutableBytes = std::span<std::byte>;
+
+template<typename T>
+concept Integer = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+inline Bytes bytes(QByteArrayView data)
+{
+    return std::as_bytes(std::span(data.data(), static_cast<std::size_t>(data.size())));
+}
+
+inline MutableBytes bytes(QByteArray &data)
+{
+    return std::as_writable_bytes(std::span(data.data(), static_cast<std::size_t>(data.size())));
+}
+
+constexpr bool fits(std::size_t size, std::size_t offset, std::size_t length)
+{
+    return offset<=size && size-offset>=length;
+}
+
+template<typename U, std::size_t... I>
+constexpr U loadBytes(Bytes data, std::size_t offset, std::index_sequence<I...>)
+{
+    // A single expression, GCC does not merge the loads of the equivalent loop
+    return ((static_cast<U>(std::to_integer<unsigned char>(data[offset+I])) << (8*I)) | ...);
+}
+
+template<typename U, std::size_t... I>
+constexpr void storeBytes(MutableBytes data, std::size_t offset, U v, std::index_sequence<I...>)
+{
+    ((data[offset+I]=static_cast<std::byte>((v >> (8*I)) & 0xff)), ...);
+}
+
+// Unchecked load, the caller has checked the range
+template<Integer T>
+constexpr T load(Bytes data, std::size_t offset)
+{
+    using U = std::make_unsigned_t<T>;
+
+    return static_cast<T>(loadBytes<U>(data, offset, std::make_index_sequence<sizeof(T)>{}));
+}
+
+// Unchecked store, the caller has checked the range
+template<Integer T>
+constexpr void store(MutableBytes data, std::size_t offset, T value)
+{
+    using U = std::make_unsigned_t<T>;
+
+    storeBytes<U>(data, offset, static_cast<U>(value), std::make_index_sequence<sizeof(T)>{});
+}
+
+template<Integer T>
+constexpr bool read(Bytes data, std::size_t offset, T &value)
+{
+    if (!fits(data.size(), offset, sizeof(T)))
+        return false;
+
+    value=load<T>(data, offset);
+
+    return true;
+}
+
+template<Integer T>
+constexpr bool write(MutableBytes data, std::size_t offset, T value)
+{
+    if (!fits(data.size(), offset, sizeof(T)))
+        return false;
+
+    store<T>(data, offset, value);
+
+    return true;
+}
+
+// Sign extended load of a 1, 2, 4 or 8 byte value, 0 if out of range
+constexpr qint64 loadSigned(Bytes data, std::size_t offset, int size)
+{
+    if (!fits(data.size(), offset, size))
+        return 0;
+
+    switch (size) {
+    case 1:
+        return load<qint8>(data, offset);
+    case 2:
+        return load<qint16>(data, offset);
+    case 4:
+        return load<qint32>(data, offset);
+    case 8:
+        return load<qint64>(data, offset);
+    default:
+        return 0;
+    }
+}
+
+namespace Check
+{
+constexpr std::array<std::byte, 8> Data {
+    std::byte{0x01}, std::byte{0x02}, std::byte{0x03}, std::byte{0x04},
+    std::byte{0xfe}, std::byte{0xff}, std::byte{0xff}, std::byte{0xff}
+};
+
+constexpr std::array<std::byte, 4> stored(qint32 v)
+{
+    std::array<std::byte, 4> d {};
+    store<qint32>(d, 0, v);
+    return d;
+}
+
+static_assert(load<quint16>(Data, 0)==0x0201);
+static_assert(load<quint32>(Data, 0)==0x04030201);
+static_assert(load<qint32>(Data, 4)==-2);
+static_assert(loadSigned(Data, 4, 2)==-2);
+static_assert(loadSigned(Data, 6, 4)==0);
+static_assert(stored(-2)[0]==std::byte{0xfe} && stored(-2)[3]==std::byte{0xff});
+static_assert(load<qint32>(stored(0x12345678), 0)==0x12345678);
+}
+
+}
+
+#endif // CAMERAWIRE_H
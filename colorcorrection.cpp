@@ -0,0 +1,101 @@
+#include "colorcorrection.h"
+#include "cameratypes.h"
+#include "fixedpoint.h"
+
+ColorCorrection::ColorCorrection(QObject *parent)
+    : QObject{parent}
+{
+
+}
+
+/**
+ * @brief ColorCorrection::decode
+ * @param msg colour correction message, category 8
+ * @return true if the state changed
+ */
+bool ColorCorrection::decode(const CutePocket::Message &msg)
+{
+    if (msg.category!=8 || msg.type!=CutePocket::Fixed16Type)
+        return false;
+
+    switch (msg.parameter) {
+    case 0:
+        if (!setTuple(m_lift, msg))
+            return false;
+        emit liftChanged();
+        return true;
+    case 1:
+        if (!setTuple(m_gamma, msg))
+            return false;
+        emit gammaChanged();
+        return true;
+    case 2:
+        if (!setTuple(m_gain, msg))
+            return false;
+        emit gainChanged();
+        return true;
+    case 3:
+        if (!setTuple(m_offset, msg))
+            return false;
+        emit offsetChanged();
+        return true;
+    case 4:
+        if (!setPair(m_contrastPivot, m_contrastAdjust, msg))
+            return false;
+        emit contrastChanged();
+        return true;
+    case 5: {
+        if (msg.payload.size()<2)
+            return false;
+
+        const double mix=msg.fixed(0);
+        if (m_lumaMix==mix)
+            return false;
+
+        m_lumaMix=mix;
+        emit lumaMixChanged();
+        return true;
+    }
+    case 6:
+        if (!setPair(m_hue, m_saturation, msg))
+            return false;
+        emit colorAdjustChanged();
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ColorCorrection::setTuple(QVector4D &tuple, const CutePocket::Message &msg)
+{
+    if (msg.payload.size()<8)
+        return false;
+
+    const CutePocket::Float4 v=CutePocket::fromFixed16x4(CutePocket::Wire::bytes(msg.payload), 0);
+    const QVector4D t(v[0], v[1], v[2], v[3]);
+
+    // Exact compare, the values come from the same fixed point codes
+    if (t.x()==tuple.x() && t.y()==tuple.y() && t.z()==tuple.z() && t.w()==tuple.w())
+        return false;
+
+    tuple=t;
+
+    return true;
+}
+
+bool ColorCorrection::setPair(double &a, double &b, const CutePocket::Message &msg)
+{
+    if (msg.payload.size()<4)
+        return false;
+
+    const double va=msg.fixed(0);
+    const double vb=msg.fixed(1);
+
+    if (a==va && b==vb)
+        return false;
+
+    a=va;
+    b=vb;
+
+    return true;
+}
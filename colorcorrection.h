@@ -0,0 +1,75 @@
+#ifndef COLORCORRECTION_H
+#define COLORCORRECTION_H
+
+#include <QObject>
+#include <QVector4D>
+#include <QtQmlIntegration/qqmlintegration.h>
+
+namespace CutePocket {
+struct Message;
+}
+
+/**
+ * @brief The ColorCorrection class
+ *
+ * Colour correction state of a camera as reported by the camera (category 8).
+ * Lift, gamma, gain and offset are red, green, blue and luma in x, y, z and w.
+ */
+class ColorCorrection : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+    QML_UNCREATABLE("Owned by CameraDevice")
+    Q_PROPERTY(QVector4D lift READ lift NOTIFY liftChanged FINAL)
+    Q_PROPERTY(QVector4D gamma READ gamma NOTIFY gammaChanged FINAL)
+    Q_PROPERTY(QVector4D gain READ gain NOTIFY gainChanged FINAL)
+    Q_PROPERTY(QVector4D offset READ offset NOTIFY offsetChanged FINAL)
+    Q_PROPERTY(double contrastPivot READ contrastPivot NOTIFY contrastChanged FINAL)
+    Q_PROPERTY(double contrastAdjust READ contrastAdjust NOTIFY contrastChanged FINAL)
+    Q_PROPERTY(double lumaMix READ lumaMix NOTIFY lumaMixChanged FINAL)
+    Q_PROPERTY(double hue READ hue NOTIFY colorAdjustChanged FINAL)
+    Q_PROPERTY(double saturation READ saturation NOTIFY colorAdjustChanged FINAL)
+
+public:
+    explicit ColorCorrection(QObject *parent = nullptr);
+
+    bool decode(const CutePocket::Message &msg);
+
+    QVector4D lift() const { return m_lift; }
+    QVector4D gamma() const { return m_gamma; }
+    QVector4D gain() const { return m_gain; }
+    QVector4D offset() const { return m_offset; }
+
+    double contrastPivot() const { return m_contrastPivot; }
+    double contrastAdjust() const { return m_contrastAdjust; }
+    double lumaMix() const { return m_lumaMix; }
+    double hue() const { return m_hue; }
+    double saturation() const { return m_saturation; }
+
+signals:
+    void liftChanged();
+    void gammaChanged();
+    void gainChanged();
+    void offsetChanged();
+    void contrastChanged();
+    void lumaMixChanged();
+    void colorAdjustChanged();
+
+private:
+    bool setTuple(QVector4D &tuple, const CutePocket::Message &msg);
+    bool setPair(double &a, double &b, const CutePocket::Message &msg);
+
+    // Camera defaults, also what a colour correction reset restores
+    QVector4D m_lift {0.0f, 0.0f, 0.0f, 0.0f};
+    QVector4D m_gamma {0.0f, 0.0f, 0.0f, 0.0f};
+    QVector4D m_gain {1.0f, 1.0f, 1.0f, 1.0f};
+    QVector4D m_offset {0.0f, 0.0f, 0.0f, 0.0f};
+
+    double m_contrastPivot=0.5;
+    double m_contrastAdjust=1.0;
+    double m_lumaMix=1.0;
+    double m_hue=0.0;
+    double m_saturation=1.0;
+};
+
+#endif // COLORCORRECTION_H
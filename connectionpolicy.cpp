@@ -0,0 +1,152 @@
+#include "connectionpolicy.h"
+#include "cameralogging.h"
+
+#include <QDebug>
+
+// Relax the connection after this long without commands
+static const int IdleTimeout = 5000;
+
+// History entries kept
+static const int MaxHistory = 32;
+
+ConnectionPolicy::ConnectionPolicy(QObject *parent)
+    : QObject{parent}
+{
+    m_idleTimer.setSingleShot(true);
+    m_idleTimer.setInterval(IdleTimeout);
+    connect(&m_idleTimer, &QTimer::timeout, this, [this]() {
+        if (!m_recording)
+            setActive(false);
+    });
+}
+
+/**
+ * @brief ConnectionPolicy::start
+ *
+ * Camera control is ready. The initial state is being exchanged, start in the active profile.
+ */
+void ConnectionPolicy::start()
+{
+    m_connected=true;
+    m_clock.start();
+    m_history.clear();
+    emit historyChanged();
+
+    // Request the active profile even if it was the last one requested on a previous connection
+    m_active=false;
+    activity();
+}
+
+void ConnectionPolicy::reset()
+{
+    m_connected=false;
+    m_recording=false;
+    m_idleTimer.stop();
+
+    if (m_active) {
+        m_active=false;
+        emit activeChanged();
+    }
+
+    m_interval=0.0;
+    m_latency=0;
+    m_supervisionTimeout=0;
+    emit parametersChanged();
+}
+
+/**
+ * @brief ConnectionPolicy::activity
+ *
+ * A command was sent, use the active profile until idle again.
+ */
+void ConnectionPolicy::activity()
+{
+    if (!m_recording)
+        m_idleTimer.start();
+
+    setActive(true);
+}
+
+void ConnectionPolicy::setRecording(bool recording)
+{
+    if (m_recording==recording)
+        return;
+
+    m_recording=recording;
+
+    if (m_recording) {
+        m_idleTimer.stop();
+        setActive(true);
+    } else {
+        m_idleTimer.start();
+    }
+}
+
+/**
+ * @brief ConnectionPolicy::setAdaptive
+ * @param adaptive
+ *
+ * When not adaptive the connection keeps the parameters it has, transitions are still tracked.
+ */
+void ConnectionPolicy::setAdaptive(bool adaptive)
+{
+    if (m_adaptive==adaptive)
+        return;
+
+    m_adaptive=adaptive;
+    emit adaptiveChanged();
+
+    if (m_adaptive && m_connected)
+        emit profileRequested(m_active ? CameraTransport::ActiveConnection : CameraTransport::IdleConnection);
+}
+
+void ConnectionPolicy::setActive(bool active)
+{
+    if (m_active==active)
+        return;
+
+    m_active=active;
+    m_transitions++;
+    emit activeChanged();
+
+    if (!m_connected)
+        return;
+
+    qCDebug(lcGatt) << "Connection profile" << (m_active ? "active" : "idle");
+
+    addHistory({ { "event", "request" }, { "active", m_active } });
+
+    if (m_adaptive)
+        emit profileRequested(m_active ? CameraTransport::ActiveConnection : CameraTransport::IdleConnection);
+}
+
+/**
+ * @brief ConnectionPolicy::parametersUpdated
+ * @param interval connection interval in ms
+ * @param latency peripheral latency in connection events
+ * @param supervisionTimeout in ms
+ */
+void ConnectionPolicy::parametersUpdated(double interval, int latency, int supervisionTimeout)
+{
+    qCDebug(lcGatt) << "Connection parameters" << interval << latency << supervisionTimeout;
+
+    m_interval=interval;
+    m_latency=latency;
+    m_supervisionTimeout=supervisionTimeout;
+    emit parametersChanged();
+
+    addHistory({ { "event", "update" }, { "interval", interval }, { "latency", latency }, { "supervisionTimeout", supervisionTimeout } });
+}
+
+void ConnectionPolicy::addHistory(const QVariantMap &entry)
+{
+    QVariantMap e=entry;
+
+    e.insert("time", m_clock.isValid() ? m_clock.elapsed() : 0);
+
+    if (m_history.size()>=MaxHistory)
+        m_history.removeFirst();
+
+    m_history.append(e);
+    emit historyChanged();
+}
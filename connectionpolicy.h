@@ -0,0 +1,86 @@
+#ifndef CONNECTIONPOLICY_H
+#define CONNECTIONPOLICY_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVariant>
+#include <QtQmlIntegration/qqmlintegration.h>
+
+#include "cameratransport.h"
+
+/**
+ * @brief The ConnectionPolicy class
+ *
+ * Chooses the connection parameter profile for one camera connection: a short
+ * connection interval while controls are being adjusted or the camera is recording,
+ * a long one when idle. Keeps the parameters the link actually negotiated and a
+ * short history of requests and updates.
+ */
+class ConnectionPolicy : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+    QML_UNCREATABLE("Owned by CameraDevice")
+    Q_PROPERTY(bool adaptive READ adaptive WRITE setAdaptive NOTIFY adaptiveChanged FINAL)
+    Q_PROPERTY(bool active READ active NOTIFY activeChanged FINAL)
+    Q_PROPERTY(int transitions READ transitions NOTIFY activeChanged FINAL)
+    Q_PROPERTY(double interval READ interval NOTIFY parametersChanged FINAL)
+    Q_PROPERTY(int latency READ latency NOTIFY parametersChanged FINAL)
+    Q_PROPERTY(int supervisionTimeout READ supervisionTimeout NOTIFY parametersChanged FINAL)
+    Q_PROPERTY(QVariantList history READ history NOTIFY historyChanged FINAL)
+
+public:
+    explicit ConnectionPolicy(QObject *parent = nullptr);
+
+    void start();
+    void reset();
+
+    void activity();
+    void setRecording(bool recording);
+
+    bool adaptive() const { return m_adaptive; }
+    void setAdaptive(bool adaptive);
+
+    bool active() const { return m_active; }
+    int transitions() const { return m_transitions; }
+
+    // Negotiated parameters, 0 until the link reports them
+    double interval() const { return m_interval; }
+    int latency() const { return m_latency; }
+    int supervisionTimeout() const { return m_supervisionTimeout; }
+
+    QVariantList history() const { return m_history; }
+
+public slots:
+    void parametersUpdated(double interval, int latency, int supervisionTimeout);
+
+signals:
+    void profileRequested(CameraTransport::ConnectionProfile profile);
+
+    void adaptiveChanged();
+    void activeChanged();
+    void parametersChanged();
+    void historyChanged();
+
+private:
+    void setActive(bool active);
+    void addHistory(const QVariantMap &entry);
+
+    QTimer m_idleTimer;
+    QElapsedTimer m_clock;
+
+    bool m_adaptive=true;
+    bool m_connected=false;
+    bool m_recording=false;
+    bool m_active=false;
+    int m_transitions=0;
+
+    double m_interval=0.0;
+    int m_latency=0;
+    int m_supervisionTimeout=0;
+
+    QVariantList m_history;
+};
+
+#endif // CONNECTIONPOLICY_H
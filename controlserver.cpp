@@ -0,0 +1,430 @@
+#include "controlserver.h"
+#include "cameramanager.h"
+#include "cameradiscovery.h"
+#include "cameradevice.h"
+#include "recordsync.h"
+#include "cameralogging.h"
+
+#include <QDebug>
+#include <QLocalSocket>
+#include <QMetaEnum>
+#include <QUrl>
+
+// Drop clients that send a line longer than this without a newline
+static const int MaxLineLength = 4096;
+
+static const char HelpText[] =
+    "help\n"
+    "list\n"
+    "status [index]\n"
+    "select <index>\n"
+    "scan on|off\n"
+    "devices\n"
+    "connect <address>|simulator|replay <file> [speed]\n"
+    "disconnect <index>|all\n"
+    "group <index> on|off\n"
+    "record on|off\n"
+    "iso <iso>\n"
+    "shutter <speed>\n"
+    "wb <kelvin> <tint>\n"
+    "aperture <f-number> [index]\n"
+    "focus <value> [abs] [index]\n"
+    "zoom <0-1> [index]\n"
+    "autofocus [index]\n"
+    "subscribe\n"
+    "quit\n";
+
+static QByteArray encoded(const QString &value)
+{
+    return QUrl::toPercentEncoding(value);
+}
+
+static QByteArray ok(const QByteArray &data=QByteArray())
+{
+    return data.isEmpty() ? QByteArrayLiteral("ok\n") : "ok "+data+'\n';
+}
+
+static QByteArray error(const QByteArray &reason)
+{
+    return "error "+reason+'\n';
+}
+
+static bool onOff(const QByteArray &arg, bool *ok)
+{
+    *ok=arg=="on" || arg=="off" || arg=="1" || arg=="0";
+
+    return arg=="on" || arg=="1";
+}
+
+ControlServer::ControlServer(CameraManager *manager, CameraDiscovery *discovery, QObject *parent)
+    : QObject{parent}
+    , m_manager(manager)
+    , m_discovery(discovery)
+{
+    connect(&m_server, &QLocalServer::newConnection, this, &ControlServer::newConnection);
+
+    connect(m_manager, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &, int first, int last) {
+        for (int i=first; i<=last; i++)
+            watchCamera(m_manager->camera(i));
+    });
+
+    connect(m_manager->sync(), &RecordSync::finished, this, [this]() {
+        RecordSync *sync=m_manager->sync();
+        publish("sync "+QByteArray::number(sync->lastSkew(), 'f', 3)+' '+QByteArray::number(sync->lastTimecodeSkew()));
+    });
+
+    for (int i=0; i<m_manager->count(); i++)
+        watchCamera(m_manager->camera(i));
+}
+
+ControlServer::~ControlServer()
+{
+    m_server.close();
+}
+
+/**
+ * @brief ControlServer::listen
+ * @param name local socket name or path
+ * @return true if the server is listening
+ *
+ * A stale socket left behind by a previous instance is removed first. The socket is
+ * only accessible to the current user.
+ */
+bool ControlServer::listen(const QString &name)
+{
+    QLocalServer::removeServer(name);
+
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+
+    if (!m_server.listen(name)) {
+        qCWarning(lcTx) << "Failed to listen on" << name << m_server.errorString();
+        return false;
+    }
+
+    qCInfo(lcTx) << "Control socket" << m_server.fullServerName();
+
+    return true;
+}
+
+QString ControlServer::serverName() const
+{
+    return m_server.fullServerName();
+}
+
+void ControlServer::newConnection()
+{
+    while (QLocalSocket *client=m_server.nextPendingConnection()) {
+        connect(client, &QLocalSocket::readyRead, this, &ControlServer::readClient);
+        connect(client, &QLocalSocket::disconnected, this, &ControlServer::clientDisconnected);
+    }
+}
+
+void ControlServer::readClient()
+{
+    QLocalSocket *client=qobject_cast<QLocalSocket *>(sender());
+    if (!client)
+        return;
+
+    while (client->canReadLine()) {
+        const QByteArray line=client->readLine().simplified();
+
+        if (line.isEmpty())
+            continue;
+
+        const QByteArray reply=execute(client, line.split(' '));
+
+        if (client->state()!=QLocalSocket::ConnectedState)
+            return;
+
+        client->write(reply);
+    }
+
+    if (client->bytesAvailable()>MaxLineLength) {
+        client->write(error("line too long"));
+        client->disconnectFromServer();
+    }
+}
+
+void ControlServer::clientDisconnected()
+{
+    QLocalSocket *client=qobject_cast<QLocalSocket *>(sender());
+    if (!client)
+        return;
+
+    m_subscribers.remove(client);
+    client->deleteLater();
+}
+
+/**
+ * @brief ControlServer::cameraArgument
+ * @param args
+ * @param i argument with the camera index
+ * @param index the resolved camera index
+ * @return camera at the index in argument i, the current camera if there is no such argument
+ */
+CameraDevice *ControlServer::cameraArgument(const QList<QByteArray> &args, int i, int *index) const
+{
+    int idx=m_manager->currentIndex();
+
+    if (args.size()>i) {
+        bool ok;
+        idx=args.at(i).toInt(&ok);
+        if (!ok)
+            return nullptr;
+    }
+
+    if (index)
+        *index=idx;
+
+    return m_manager->camera(idx);
+}
+
+QByteArray ControlServer::execute(QLocalSocket *client, const QList<QByteArray> &args)
+{
+    const QByteArray &cmd=args.first();
+    const int argc=args.size();
+    bool ok=false;
+
+    if (cmd=="help")
+        return HelpText+::ok();
+
+    if (cmd=="quit") {
+        client->write(::ok());
+        client->disconnectFromServer();
+        return QByteArray();
+    }
+
+    if (cmd=="list")
+        return cameraList()+::ok();
+
+    if (cmd=="devices") {
+        if (!m_discovery)
+            return error("no discovery");
+        return deviceList()+::ok();
+    }
+
+    if (cmd=="status") {
+        int index;
+        if (!cameraArgument(args, 1, &index))
+            return error("no camera");
+        return ::ok(cameraStatus(index));
+    }
+
+    if (cmd=="select" && argc==2) {
+        const int index=args.at(1).toInt(&ok);
+        if (!ok || !m_manager->camera(index))
+            return error("no camera");
+        m_manager->setCurrentIndex(index);
+        return ::ok();
+    }
+
+    if (cmd=="scan" && argc==2) {
+        const bool on=onOff(args.at(1), &ok);
+        if (!ok || !m_discovery)
+            return error("invalid argument");
+        if (on)
+            m_discovery->startDeviceDiscovery();
+        else
+            m_discovery->stopDeviceDiscovery();
+        return ::ok();
+    }
+
+    if (cmd=="connect" && argc>=2) {
+        CameraDevice *device=nullptr;
+
+        if (args.at(1)=="simulator") {
+            device=m_manager->connectSimulator();
+        } else if (args.at(1)=="replay" && argc>=3) {
+            const double speed=argc>=4 ? args.at(3).toDouble(&ok) : 1.0;
+            if (argc>=4 && !ok)
+                return error("invalid speed");
+            device=m_manager->connectReplay(QUrl::fromPercentEncoding(args.at(2)), speed);
+        } else {
+            if (!m_discovery)
+                return error("no discovery");
+            const QBluetoothDeviceInfo info=m_discovery->getBluetoothDevice(QString::fromLatin1(args.at(1)));
+            if (!info.isValid())
+                return error("unknown device");
+            device=m_manager->connectCamera(info);
+        }
+
+        if (!device)
+            return error("connect failed");
+
+        return ::ok(QByteArray::number(m_manager->indexOf(device)));
+    }
+
+    if (cmd=="disconnect" && argc==2) {
+        if (args.at(1)=="all") {
+            m_manager->disconnectAll();
+            return ::ok();
+        }
+        const int index=args.at(1).toInt(&ok);
+        if (!ok || !m_manager->camera(index))
+            return error("no camera");
+        m_manager->removeCamera(index);
+        return ::ok();
+    }
+
+    if (cmd=="group" && argc==3) {
+        const int index=args.at(1).toInt(&ok);
+        if (!ok || !m_manager->camera(index))
+            return error("no camera");
+        const bool on=onOff(args.at(2), &ok);
+        if (!ok)
+            return error("invalid argument");
+        m_manager->setGrouped(index, on);
+        return ::ok();
+    }
+
+    if (cmd=="record" && argc==2) {
+        const bool on=onOff(args.at(1), &ok);
+        if (!ok)
+            return error("invalid argument");
+        return ::ok(QByteArray::number(m_manager->record(on)));
+    }
+
+    if (cmd=="iso" && argc==2) {
+        const int iso=args.at(1).toInt(&ok);
+        if (!ok)
+            return error("invalid iso");
+        return ::ok(QByteArray::number(m_manager->setISO(iso)));
+    }
+
+    if (cmd=="shutter" && argc==2) {
+        const int shutter=args.at(1).toInt(&ok);
+        if (!ok)
+            return error("invalid shutter speed");
+        return ::ok(QByteArray::number(m_manager->setShutterSpeed(shutter)));
+    }
+
+    if (cmd=="wb" && argc==3) {
+        bool tintOk;
+        const int wb=args.at(1).toInt(&ok);
+        const int tint=args.at(2).toInt(&tintOk);
+        if (!ok || !tintOk)
+            return error("invalid white balance");
+        return ::ok(QByteArray::number(m_manager->whiteBalance(wb, tint)));
+    }
+
+    if (cmd=="aperture" && argc>=2) {
+        const double f=args.at(1).toDouble(&ok);
+        CameraDevice *device=cameraArgument(args, 2);
+        if (!ok || !device)
+            return error("invalid argument");
+        return device->setAperture(f) ? ::ok() : error("write failed");
+    }
+
+    if (cmd=="focus" && argc>=2) {
+        const int value=args.at(1).toInt(&ok);
+        const bool absolute=argc>=3 && args.at(2)=="abs";
+        CameraDevice *device=cameraArgument(args, absolute ? 3 : 2);
+        if (!ok || !device)
+            return error("invalid argument");
+        return device->focus(value, !absolute) ? ::ok() : error("write failed");
+    }
+
+    if (cmd=="zoom" && argc>=2) {
+        const double zoom=args.at(1).toDouble(&ok);
+        CameraDevice *device=cameraArgument(args, 2);
+        if (!ok || !device)
+            return error("invalid argument");
+        return device->zoom(zoom) ? ::ok() : error("write failed");
+    }
+
+    if (cmd=="autofocus") {
+        CameraDevice *device=cameraArgument(args, 1);
+        if (!device)
+            return error("no camera");
+        return device->autoFocus() ? ::ok() : error("write failed");
+    }
+
+    if (cmd=="subscribe") {
+        m_subscribers.insert(client);
+        return ::ok();
+    }
+
+    return error("unknown command "+cmd);
+}
+
+QByteArray ControlServer::cameraList() const
+{
+    QByteArray list;
+
+    for (int i=0; i<m_manager->count(); i++) {
+        const QModelIndex index=m_manager->index(i);
+
+        list+="camera "+QByteArray::number(i)
+              +' '+encoded(index.data(CameraManager::AddressRole).toString())
+              +' '+encoded(index.data(CameraManager::NameRole).toString())
+              +" connected="+QByteArray::number(index.data(CameraManager::ConnectedRole).toBool())
+              +" recording="+QByteArray::number(index.data(CameraManager::RecordingRole).toBool())
+              +" grouped="+QByteArray::number(index.data(CameraManager::GroupRole).toBool())
+              +'\n';
+    }
+
+    return list;
+}
+
+QByteArray ControlServer::deviceList() const
+{
+    QByteArray list;
+
+    for (int i=0; i<m_discovery->count(); i++) {
+        const QModelIndex index=m_discovery->index(i);
+
+        list+="device "+encoded(index.data(CameraDiscovery::AddressRole).toString())
+              +' '+encoded(index.data(CameraDiscovery::NameRole).toString())
+              +" rssi="+QByteArray::number(index.data(CameraDiscovery::RssiRole).toInt())
+              +'\n';
+    }
+
+    return list;
+}
+
+QByteArray ControlServer::cameraStatus(int index) const
+{
+    const CameraDevice *d=m_manager->camera(index);
+    const QMetaEnum states=QMetaEnum::fromType<CameraDevice::ConnectionState>();
+
+    return "index="+QByteArray::number(index)
+           +" address="+encoded(m_manager->addressOf(d))
+           +" name="+encoded(d->name())
+           +" state="+states.valueToKey(d->connectionState())
+           +" recording="+QByteArray::number(d->recording())
+           +" playing="+QByteArray::number(d->playing())
+           +" iso="+QByteArray::number(d->iso())
+           +" shutter="+QByteArray::number(d->shutterSpeed())
+           +" wb="+QByteArray::number(d->wb())
+           +" tint="+QByteArray::number(d->tint())
+           +" aperture="+QByteArray::number(d->apterture(), 'f', 1)
+           +" zoom="+QByteArray::number(d->zoom())
+           +" fps="+QByteArray::number(d->frameRate())
+           +" timecode="+d->timecode()->text().toLatin1();
+}
+
+void ControlServer::watchCamera(CameraDevice *device)
+{
+    if (!device)
+        return;
+
+    connect(device, &CameraDevice::connectionStateChanged, this, [this, device]() {
+        const QMetaEnum states=QMetaEnum::fromType<CameraDevice::ConnectionState>();
+        publish("state "+encoded(m_manager->addressOf(device))+' '+states.valueToKey(device->connectionState()));
+    });
+
+    connect(device, &CameraDevice::recordingChanged, this, [this, device]() {
+        publish("recording "+encoded(m_manager->addressOf(device))+' '+QByteArray::number(device->recording()));
+    });
+}
+
+void ControlServer::publish(const QByteArray &event)
+{
+    if (m_subscribers.isEmpty())
+        return;
+
+    const QByteArray line="event "+event+'\n';
+
+    for (QLocalSocket *client : std::as_const(m_subscribers))
+        client->write(line);
+}
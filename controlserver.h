@@ -0,0 +1,60 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QLocalServer>
+#include <QPointer>
+#include <QSet>
+
+class QLocalSocket;
+class CameraManager;
+class CameraDiscovery;
+class CameraDevice;
+
+/**
+ * @brief The ControlServer class
+ *
+ * Local socket control interface for headless mode. Clients send one command per
+ * line, words separated by spaces, and get one reply line starting with "ok" or
+ * "error". Multi line replies end with a line containing only "ok". Subscribed
+ * clients also get "event" lines for camera state changes.
+ *
+ * String values in replies are percent encoded so every reply splits on spaces.
+ */
+class ControlServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ControlServer(CameraManager *manager, CameraDiscovery *discovery, QObject *parent = nullptr);
+    ~ControlServer();
+
+    bool listen(const QString &name);
+    QString serverName() const;
+
+private slots:
+    void newConnection();
+    void readClient();
+    void clientDisconnected();
+
+private:
+    QByteArray execute(QLocalSocket *client, const QList<QByteArray> &args);
+
+    QByteArray cameraList() const;
+    QByteArray deviceList() const;
+    QByteArray cameraStatus(int index) const;
+
+    CameraDevice *cameraArgument(const QList<QByteArray> &args, int i, int *index = nullptr) const;
+
+    void watchCamera(CameraDevice *device);
+    void publish(const QByteArray &event);
+
+    QLocalServer m_server;
+    QPointer<CameraManager> m_manager;
+    QPointer<CameraDiscovery> m_discovery;
+
+    QSet<QLocalSocket *> m_subscribers;
+};
+
+#endif // CONTROLSERVER_H
@@ -0,0 +1,155 @@
+#ifndef FIXEDPOINT_H
+#define FIXEDPOINT_H
+
+#include <QtGlobal>
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#include "camerawire.h"
+
+namespace CutePocket
+{
+
+/*
+ * Camera control fixed16 values are signed 5.11 fixed point, range [-16.0, 16.0).
+ */
+
+constexpr int FixedFractionBits = 11;
+constexpr double FixedScale = 1 << FixedFractionBits;
+
+constexpr double FixedMin = -32768.0/FixedScale;
+constexpr double FixedMax = 32767.0/FixedScale;
+
+constexpr double fromFixed16(qint16 v)
+{
+    return v/FixedScale;
+}
+
+/**
+ * @brief toFixed16
+ * @param v
+ * @return v rounded to the nearest 5.11 value, halfway cases away from zero, saturated to the fixed16 range
+ *
+ * The clamps and the sign select compile to min/max and a conditional move, the
+ * conversion has no data dependent branches.
+ */
+constexpr qint16 toFixed16(double v)
+{
+    // NaN compares false and ends up as 0
+    const double s=v==v ? v*FixedScale : 0.0;
+    const double c=s<-32768.0 ? -32768.0 : (s>32767.0 ? 32767.0 : s);
+
+    return static_cast<qint16>(c+(c<0.0 ? -0.5 : 0.5));
+}
+
+namespace Detail
+{
+// 2^x for x in [0, 1), Taylor series of e^(x ln 2), accurate to double precision
+constexpr double exp2Fraction(double x)
+{
+    const double y=x*0.693147180559945309417232121458176568;
+
+    double term=1.0;
+    double sum=1.0;
+    for (int n=1; n<24; n++) {
+        term*=y/n;
+        sum+=term;
+    }
+
+    return sum;
+}
+
+// The f-number is 2^(code/4096), the table covers the fractional part of the exponent
+constexpr int ApertureTableBits = 12;
+constexpr int ApertureTableSize = 1 << ApertureTableBits;
+
+constexpr std::array<double, ApertureTableSize> apertureTable()
+{
+    std::array<double, ApertureTableSize> t {};
+
+    for (int i=0; i<ApertureTableSize; i++)
+        t[i]=exp2Fraction(double(i)/ApertureTableSize);
+
+    return t;
+}
+
+inline constexpr std::array<double, ApertureTableSize> ApertureTable=apertureTable();
+}
+
+/**
+ * @brief apertureFromFixed16
+ * @param v aperture value, log2 of the squared f-number in fixed16
+ * @return f-number
+ */
+inline double apertureFromFixed16(qint16 v)
+{
+    const int code=v;
+
+    // Arithmetic shift and mask split the exponent into integer and fractional parts, also for negative codes
+    return std::ldexp(Detail::ApertureTable[code & (Detail::ApertureTableSize-1)], code >> Detail::ApertureTableBits);
+}
+
+/**
+ * @brief apertureToFixed16
+ * @param fnumber
+ * @return aperture value in fixed16
+ */
+inline qint16 apertureToFixed16(double fnumber)
+{
+    return toFixed16(2.0*std::log2(fnumber));
+}
+
+/*
+ * Colour correction RGBL tuples, plain 4-lane loops without cross-lane dependencies
+ * that the compiler can vectorize without target specific code.
+ */
+
+using Fixed16x4 = std::array<qint16, 4>;
+using Float4 = std::array<float, 4>;
+
+// Four consecutive fixed16 values, the caller has checked the range
+inline Float4 fromFixed16x4(Wire::Bytes data, std::size_t offset)
+{
+    // Loads and conversion in separate loops, the conversion vectorizes
+    Fixed16x4 v;
+    for (std::size_t i=0; i<4; i++)
+        v[i]=Wire::load<qint16>(data, offset+2*i);
+
+    Float4 r;
+    for (std::size_t i=0; i<4; i++)
+        r[i]=v[i]*(1.0f/float(FixedScale));
+
+    return r;
+}
+
+// As toFixed16, but NaN saturates to the maximum instead of a data dependent select
+constexpr Fixed16x4 toFixed16x4(const Float4 &v)
+{
+    Fixed16x4 r {};
+
+    for (std::size_t i=0; i<4; i++) {
+        float c=v[i]*float(FixedScale);
+        c=c<32767.0f ? c : 32767.0f;
+        c=c>-32768.0f ? c : -32768.0f;
+        r[i]=static_cast<qint16>(c+(c<0.0f ? -0.5f : 0.5f));
+    }
+
+    return r;
+}
+
+static_assert(toFixed16x4({ 1.0f, -1.5f, 0.25f, 100.0f })==Fixed16x4 { 2048, -3072, 512, 32767 });
+static_assert(toFixed16x4({ 0.5f/2048, -0.5f/2048, -100.0f, 0.0f })==Fixed16x4 { 1, -1, -32768, 0 });
+
+static_assert(toFixed16(1.0)==2048 && toFixed16(-1.0)==-2048);
+static_assert(toFixed16(-1.5)==-3072 && toFixed16(0.25)==512);
+static_assert(toFixed16(0.5/2048)==1 && toFixed16(-0.5/2048)==-1 && toFixed16(0.49/2048)==0);
+static_assert(toFixed16(100.0)==32767 && toFixed16(-100.0)==-32768);
+static_assert(fromFixed16(toFixed16(FixedMax))==FixedMax && fromFixed16(toFixed16(FixedMin))==FixedMin);
+static_assert(Detail::ApertureTable[0]==1.0);
+static_assert(Detail::ApertureTable[2048]>1.41421356237309 && Detail::ApertureTable[2048]<1.41421356237310);
+
+}
+
+#endif // FIXEDPOINT_H
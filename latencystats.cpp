@@ -0,0 +1,274 @@
+#include "latencystats.h"
+#include "cameralogging.h"
+
+#include <QDebug>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include <bit>
+#include <cmath>
+
+// Commands not echoed within this time are counted as unmatched, in microseconds
+static const qint64 EchoTimeout = 2000000;
+
+// Throttle QML updates while commands are streaming
+static const int UpdateInterval = 500;
+
+int LatencyHistogram::bucket(quint64 value)
+{
+    value=qMin<quint64>(value, 0xffffffff);
+
+    if (value<SubBuckets)
+        return value;
+
+    const int e=std::bit_width(value)-1;
+    const int shift=e-SubBits;
+
+    return SubBuckets*(shift+1)+((value >> shift) & (SubBuckets-1));
+}
+
+// Middle of the bucket range
+quint64 LatencyHistogram::bucketValue(int bucket)
+{
+    if (bucket<SubBuckets)
+        return bucket;
+
+    const int shift=bucket/SubBuckets-1;
+    const quint64 lower=quint64(SubBuckets+bucket%SubBuckets) << shift;
+
+    return lower+((quint64(1) << shift) >> 1);
+}
+
+void LatencyHistogram::add(quint64 value)
+{
+    m_buckets[bucket(value)]++;
+    m_count++;
+    m_sum+=value;
+    m_max=qMax(m_max, value);
+}
+
+void LatencyHistogram::clear()
+{
+    m_buckets.fill(0);
+    m_count=0;
+    m_sum=0;
+    m_max=0;
+}
+
+/**
+ * @brief LatencyHistogram::percentile
+ * @param p percentile, 0-1
+ * @return value at the percentile, 0 if there are no samples
+ */
+quint64 LatencyHistogram::percentile(double p) const
+{
+    if (m_count==0)
+        return 0;
+
+    const quint64 target=qMax<quint64>(1, std::ceil(p*m_count));
+    quint64 n=0;
+
+    for (int i=0; i<Buckets; i++) {
+        n+=m_buckets[i];
+        if (n>=target)
+            return qMin(bucketValue(i), m_max);
+    }
+
+    return m_max;
+}
+
+LatencyStats::LatencyStats(QObject *parent)
+    : QObject{parent}
+{
+    m_clock.start();
+
+    m_updateTimer.setSingleShot(true);
+    m_updateTimer.setInterval(UpdateInterval);
+    connect(&m_updateTimer, &QTimer::timeout, this, &LatencyStats::updated);
+}
+
+/**
+ * @brief LatencyStats::commandQueued
+ * @param category
+ * @param parameter
+ * @param queueDepth commands pending in the queue after this one
+ *
+ * Repeated commands for a parameter before it is echoed keep the first timestamp, the
+ * latency is how long the user waited for the camera to follow.
+ */
+void LatencyStats::commandQueued(quint8 category, quint8 parameter, qsizetype queueDepth)
+{
+    const qint64 t=now();
+
+    expire(t);
+
+    const quint16 k=key(category, parameter);
+    if (!m_sentAt.contains(k))
+        m_sentAt.insert(k, t);
+
+    m_queueDepth.add(queueDepth);
+
+    scheduleUpdate();
+}
+
+void LatencyStats::messageReceived(quint8 category, quint8 parameter)
+{
+    const auto sent=m_sentAt.constFind(key(category, parameter));
+
+    if (sent==m_sentAt.constEnd())
+        return;
+
+    m_echo[sent.key()].latency.add(now()-sent.value());
+    m_sentAt.erase(sent);
+
+    scheduleUpdate();
+}
+
+void LatencyStats::expire(qint64 time)
+{
+    for (auto i=m_sentAt.begin(); i!=m_sentAt.end();) {
+        if (time-i.value()>EchoTimeout) {
+            m_echo[i.key()].unmatched++;
+            i=m_sentAt.erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+/**
+ * @brief LatencyStats::clearPending
+ *
+ * Connection lost, nothing in flight will be echoed.
+ */
+void LatencyStats::clearPending()
+{
+    m_sentAt.clear();
+    m_writeStart=-1;
+}
+
+void LatencyStats::writeStarted()
+{
+    m_writeStart=now();
+}
+
+void LatencyStats::writeCompleted()
+{
+    if (m_writeStart<0)
+        return;
+
+    m_writes.add(now()-m_writeStart);
+    m_writeStart=-1;
+
+    scheduleUpdate();
+}
+
+void LatencyStats::writeFailed()
+{
+    m_writeFailures++;
+    m_writeStart=-1;
+
+    scheduleUpdate();
+}
+
+void LatencyStats::reset()
+{
+    m_sentAt.clear();
+    m_echo.clear();
+    m_writes.clear();
+    m_writeFailures=0;
+    m_writeStart=-1;
+    m_queueDepth.clear();
+
+    emit updated();
+}
+
+void LatencyStats::scheduleUpdate()
+{
+    if (!m_updateTimer.isActive())
+        m_updateTimer.start();
+}
+
+QVariantMap LatencyStats::summary(const LatencyHistogram &h, double scale)
+{
+    return QVariantMap {
+        { "count", h.count() },
+        { "mean", h.mean()*scale },
+        { "p50", h.percentile(0.50)*scale },
+        { "p95", h.percentile(0.95)*scale },
+        { "p99", h.percentile(0.99)*scale },
+        { "max", h.max()*scale }
+    };
+}
+
+/**
+ * @brief LatencyStats::parameters
+ * @return echo latency summary for each category/parameter that has been sent
+ */
+QVariantList LatencyStats::parameters() const
+{
+    QVariantList list;
+
+    for (auto i=m_echo.cbegin(); i!=m_echo.cend(); ++i) {
+        QVariantMap m=summary(i->latency, 0.001);
+
+        m.insert("category", i.key() >> 8);
+        m.insert("parameter", i.key() & 0xff);
+        m.insert("unmatched", i->unmatched);
+
+        list.append(m);
+    }
+
+    return list;
+}
+
+QVariantMap LatencyStats::writes() const
+{
+    QVariantMap m=summary(m_writes, 0.001);
+
+    m.insert("failed", m_writeFailures);
+
+    return m;
+}
+
+QVariantMap LatencyStats::queue() const
+{
+    return summary(m_queueDepth, 1.0);
+}
+
+/**
+ * @brief LatencyStats::dump
+ * @param file
+ * @return true if the statistics were written
+ *
+ * Write all statistics as CSV.
+ */
+bool LatencyStats::dump(const QString &file) const
+{
+    QSaveFile f(file);
+
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qCWarning(lcGatt) << "Failed to write latency statistics" << file << f.errorString();
+        return false;
+    }
+
+    QTextStream out(&f);
+
+    const auto row=[&out](const QString &kind, const QString &id, const LatencyHistogram &h, double scale, quint32 errors) {
+        out << kind << ',' << id << ',' << h.count() << ',' << h.mean()*scale << ','
+            << h.percentile(0.50)*scale << ',' << h.percentile(0.95)*scale << ',' << h.percentile(0.99)*scale << ','
+            << h.max()*scale << ',' << errors << '\n';
+    };
+
+    out << "kind,id,count,mean,p50,p95,p99,max,errors\n";
+
+    for (auto i=m_echo.cbegin(); i!=m_echo.cend(); ++i)
+        row("echo", QStringLiteral("%1.%2").arg(i.key() >> 8).arg(i.key() & 0xff), i->latency, 0.001, i->unmatched);
+
+    row("write", QString(), m_writes, 0.001, m_writeFailures);
+    row("queue", QString(), m_queueDepth, 1.0, 0);
+
+    out.flush();
+
+    return f.commit();
+}
@@ -0,0 +1,114 @@
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QTimer>
+#include <QVariant>
+#include <QtQmlIntegration/qqmlintegration.h>
+
+#include <array>
+
+/**
+ * @brief The LatencyHistogram class
+ *
+ * Fixed size log-linear histogram, exact below 8 and with 8 sub-buckets per power of two
+ * above that, so percentiles are within 12.5% of the recorded value.
+ */
+class LatencyHistogram
+{
+public:
+    void add(quint64 value);
+    void clear();
+
+    quint64 percentile(double p) const;
+
+    quint64 count() const { return m_count; }
+    quint64 max() const { return m_max; }
+    double mean() const { return m_count ? double(m_sum)/m_count : 0.0; }
+
+private:
+    static constexpr int SubBits = 3;
+    static constexpr int SubBuckets = 1 << SubBits;
+    static constexpr int Buckets = SubBuckets*30;
+
+    static int bucket(quint64 value);
+    static quint64 bucketValue(int bucket);
+
+    std::array<quint32, Buckets> m_buckets {};
+    quint64 m_count=0;
+    quint64 m_sum=0;
+    quint64 m_max=0;
+};
+
+/**
+ * @brief The LatencyStats class
+ *
+ * Command round trip instrumentation for one camera. Outgoing commands are timestamped
+ * by category and parameter when issued and matched against the camera echoing the
+ * parameter back. Also tracks command queue depth and write acknowledgement times.
+ * Times are in milliseconds.
+ */
+class LatencyStats : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+    QML_UNCREATABLE("Owned by CameraDevice")
+    Q_PROPERTY(QVariantList parameters READ parameters NOTIFY updated FINAL)
+    Q_PROPERTY(QVariantMap writes READ writes NOTIFY updated FINAL)
+    Q_PROPERTY(QVariantMap queue READ queue NOTIFY updated FINAL)
+
+public:
+    explicit LatencyStats(QObject *parent = nullptr);
+
+    void commandQueued(quint8 category, quint8 parameter, qsizetype queueDepth);
+    void messageReceived(quint8 category, quint8 parameter);
+    void clearPending();
+
+    // Commands waiting for an echo, incoming packets only need matching while true
+    bool waiting() const { return !m_sentAt.isEmpty(); }
+
+    QVariantList parameters() const;
+    QVariantMap writes() const;
+    QVariantMap queue() const;
+
+    Q_INVOKABLE bool dump(const QString &file) const;
+    Q_INVOKABLE void reset();
+
+public slots:
+    void writeStarted();
+    void writeCompleted();
+    void writeFailed();
+
+signals:
+    void updated();
+
+private:
+    struct EchoStats {
+        LatencyHistogram latency;
+        quint32 unmatched=0;
+    };
+
+    static quint16 key(quint8 category, quint8 parameter) { return (category << 8) | parameter; }
+    static QVariantMap summary(const LatencyHistogram &h, double scale);
+
+    qint64 now() const { return m_clock.nsecsElapsed()/1000; }
+    void expire(qint64 time);
+    void scheduleUpdate();
+
+    QElapsedTimer m_clock;
+    QTimer m_updateTimer;
+
+    QHash<quint16, qint64> m_sentAt;
+    QMap<quint16, EchoStats> m_echo;
+
+    LatencyHistogram m_writes;
+    quint32 m_writeFailures=0;
+    qint64 m_writeStart=-1;
+
+    LatencyHistogram m_queueDepth;
+};
+
+#endif // LATENCYSTATS_H
@@ -8,27 +8,91 @@
 
 #include "cameradiscovery.h"
 #include "cameradevice.h"
+#include "cameramanager.h"
+#include "controlserver.h"
 
 #ifdef Q_OS_WIN32
 #include <windows.h>
 #endif
 
-int main(int argc, char *argv[])
-{
-    QGuiApplication app(argc, argv);
+// Default control socket name in headless mode
+static const char DefaultSocketName[] = "cutepocketremote";
 
+static void setupApplication()
+{
     QCoreApplication::setOrganizationDomain("org.tal.cutepocketcamera");
     QCoreApplication::setOrganizationName("tal.org");
     QCoreApplication::setApplicationName("CutePocketCamera");
     QCoreApplication::setApplicationVersion("0.1");
-    
+
 #ifdef DEBUG
-    QLoggingCategory::setFilterRules(QStringLiteral("qt.bluetooth* = true"));
+    QLoggingCategory::setFilterRules(QStringLiteral("qt.bluetooth* = true\ncutepocket.* = true"));
 #endif
+}
+
+// The application type depends on the mode, so look for the flag before creating it
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int i=1; i<argc; i++) {
+        if (qstrcmp(argv[i], "--headless")==0)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief runHeadless
+ *
+ * Discovery and camera control without a GUI or QML engine, controlled over a local socket.
+ */
+static int runHeadless(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    setupApplication();
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOption({ "headless", "Run without user interface, controlled over a local socket." });
+    parser.addOption({ "socket", "Control socket name or path.", "name", DefaultSocketName });
+    parser.process(app);
+
+    qRegisterMetaType<QBluetoothDeviceInfo>();
+
+    CameraDiscovery discovery;
+    CameraManager manager;
+
+    manager.setDiscovery(&discovery);
+    discovery.setContinuous(true);
+
+    ControlServer server(&manager, &discovery);
+    if (!server.listen(parser.value("socket")))
+        return 1;
+
+    discovery.startDeviceDiscovery();
+
+    const int r=app.exec();
+
+    manager.disconnectAll();
+
+    return r;
+}
+
+int main(int argc, char *argv[])
+{
+    if (isHeadless(argc, argv))
+        return runHeadless(argc, argv);
+
+    QGuiApplication app(argc, argv);
+
+    setupApplication();
 
     qmlRegisterType<CameraDevice>("org.tal", 1,0, "CameraDevice");
+    qmlRegisterType<CameraManager>("org.tal", 1,0, "CameraManager");
     qmlRegisterType<CameraDiscovery>("org.tal", 1,0, "CameraDiscovery");
-    qRegisterMetaType<QBluetoothDeviceInfo *>("BluetoothDeviceInfo");
+    qRegisterMetaType<QBluetoothDeviceInfo>();
 
     //QQuickStyle::setStyle("Universal");
     //QQuickStyle::setStyle("Material");
@@ -0,0 +1,559 @@
+#include <QtTest>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "cameradevice.h"
+#include "cameratransport.h"
+#include "cameratypes.h"
+#include "camerawire.h"
+#include "cameracommand.h"
+#include "fixedpoint.h"
+
+/*
+ * Protocol micro benchmarks, no Bluetooth adapter needed. Run with -o results.xml,xml
+ * or -csv for machine readable results.
+ */
+
+static std::atomic<bool> countingAllocations=false;
+static std::atomic<quint64> allocationCount=0;
+
+static void countAllocation()
+{
+    if (countingAllocations.load(std::memory_order_relaxed))
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Heap allocations are counted by replacing the global operator new, which works with
+ * any standard library. Qt containers allocate with malloc() and not new, with glibc the
+ * malloc entry points are interposed as well and operator new is counted there.
+ */
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+static void *allocate(std::size_t size)
+{
+#if !defined(__GLIBC__)
+    countAllocation();
+#endif
+    void *p=std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+/**
+ * @brief The BenchmarkTransport class
+ *
+ * Always ready, writes complete immediately. Incoming packets are delivered by emitting controlReceived.
+ */
+class BenchmarkTransport : public CameraTransport
+{
+    Q_OBJECT
+public:
+    void connectToDevice(const QBluetoothDeviceInfo &device) override { Q_UNUSED(device) }
+    void disconnectFromDevice() override {}
+    bool isReady() const override { return true; }
+
+    bool writeControl(const QByteArray &data, WriteMode mode) override
+    {
+        written+=data.size();
+        if (mode==AcknowledgedWrite)
+            emit controlWritten();
+        return true;
+    }
+
+    bool writeName(const QByteArray &name) override { Q_UNUSED(name) return true; }
+
+    QString name() const override { return QStringLiteral("Benchmark"); }
+    QString address() const override { return QStringLiteral("00:00:00:00:00:00"); }
+
+    qsizetype written=0;
+};
+
+class NotifyReceiver : public QObject
+{
+    Q_OBJECT
+public slots:
+    void changed() { notifications++; }
+
+public:
+    quint64 notifications=0;
+};
+
+struct CorpusEntry
+{
+    quint8 category;
+    quint8 parameter;
+    quint8 type;
+    quint8 count;
+    const char *name;
+};
+
+// Every parameter the camera reports, as in the CameraDevice decoder table
+static const CorpusEntry corpus[] = {
+    { 0, 0, CutePocket::Fixed16Type, 1, "Focus" },
+    { 0, 1, CutePocket::VoidType, 0, "Instantaneous autofocus" },
+    { 0, 2, CutePocket::Fixed16Type, 1, "Aperture f-stop" },
+    { 0, 3, CutePocket::Fixed16Type, 1, "Aperture normalized" },
+    { 0, 6, CutePocket::VoidType, 0, "OIS" },
+    { 0, 7, CutePocket::Int16Type, 1, "Zoom" },
+    { 0, 8, CutePocket::Fixed16Type, 1, "Zoom normalized" },
+    { 0, 9, CutePocket::Fixed16Type, 1, "Zoom continuous" },
+    { 1, 0, CutePocket::Int8Type, 5, "Video mode" },
+    { 1, 2, CutePocket::Int16Type, 2, "White balance" },
+    { 1, 3, CutePocket::VoidType, 0, "AutoWB triggered" },
+    { 1, 4, CutePocket::VoidType, 0, "AutoWB restored" },
+    { 1, 5, CutePocket::Int32Type, 1, "Exposure" },
+    { 1, 7, CutePocket::Int8Type, 1, "Dynamic range mode" },
+    { 1, 8, CutePocket::Int8Type, 1, "Sharpening" },
+    { 1, 9, CutePocket::Int16Type, 5, "Recording format" },
+    { 1, 10, CutePocket::Int8Type, 1, "Auto exposure mode" },
+    { 1, 11, CutePocket::Int32Type, 1, "Shutter angle" },
+    { 1, 12, CutePocket::Int32Type, 1, "Shutter speed" },
+    { 1, 13, CutePocket::Int8Type, 1, "Gain" },
+    { 1, 14, CutePocket::Int32Type, 1, "ISO" },
+    { 1, 15, CutePocket::Int8Type, 2, "LUT" },
+    { 1, 16, CutePocket::Fixed16Type, 1, "ND" },
+    { 2, 1, CutePocket::Fixed16Type, 1, "Headphone level" },
+    { 2, 2, CutePocket::Fixed16Type, 1, "Headphone program mix" },
+    { 2, 3, CutePocket::Int8Type, 1, "Input type" },
+    { 2, 4, CutePocket::Fixed16Type, 2, "Input levels" },
+    { 2, 6, CutePocket::VoidType, 0, "Phantom power" },
+    { 3, 3, CutePocket::Int8Type, 4, "Overlays" },
+    { 4, 0, CutePocket::Fixed16Type, 1, "Brightness" },
+    { 4, 1, CutePocket::Int16Type, 1, "Exposure and focus tools" },
+    { 4, 2, CutePocket::Fixed16Type, 1, "Zebra level" },
+    { 4, 3, CutePocket::Fixed16Type, 1, "Peaking level" },
+    { 4, 4, CutePocket::Int8Type, 1, "Color bar" },
+    { 4, 5, CutePocket::Int8Type, 2, "Focus assist" },
+    { 4, 6, CutePocket::Int8Type, 1, "Return feed" },
+    { 4, 7, CutePocket::Int8Type, 1, "Time display" },
+    { 6, 0, CutePocket::Int8Type, 1, "Reference source" },
+    { 6, 1, CutePocket::Int32Type, 1, "Reference offset" },
+    { 8, 0, CutePocket::Fixed16Type, 4, "Lift" },
+    { 8, 1, CutePocket::Fixed16Type, 4, "Gamma" },
+    { 8, 2, CutePocket::Fixed16Type, 4, "Gain" },
+    { 8, 3, CutePocket::Fixed16Type, 4, "Offset" },
+    { 8, 4, CutePocket::Fixed16Type, 2, "Contrast" },
+    { 8, 5, CutePocket::Fixed16Type, 1, "Luma mix" },
+    { 8, 6, CutePocket::Fixed16Type, 2, "Color adjust" },
+    { 9, 0, CutePocket::Int8Type, 1, "Status" },
+    { 9, 1, CutePocket::Int8Type, 1, "Status USB" },
+    { 9, 2, CutePocket::Int8Type, 1, "Status time left" },
+    { 9, 7, CutePocket::Int8Type, 1, "Status assists" },
+    { 10, 0, CutePocket::Int8Type, 2, "Codec" },
+    { 10, 1, CutePocket::Int8Type, 4, "Transport mode" },
+    { 10, 2, CutePocket::Int8Type, 1, "Playback" },
+    { 10, 3, CutePocket::VoidType, 0, "Capture" },
+    { 12, 0, CutePocket::Int16Type, 1, "Reel" },
+    { 12, 1, CutePocket::Int8Type, 1, "Scene tags" },
+    { 12, 2, CutePocket::StringType, 0, "Scene" },
+    { 12, 3, CutePocket::Int8Type, 2, "Take" },
+    { 12, 4, CutePocket::Int8Type, 1, "Good take" },
+    { 12, 5, CutePocket::StringType, 0, "Camera ID" },
+    { 12, 6, CutePocket::StringType, 0, "Camera operator" },
+    { 12, 7, CutePocket::StringType, 0, "Director" },
+    { 12, 8, CutePocket::StringType, 0, "Project name" },
+    { 12, 9, CutePocket::StringType, 0, "Lens type" },
+    { 12, 10, CutePocket::StringType, 0, "Lens iris" },
+    { 12, 11, CutePocket::StringType, 0, "Lens focal length" },
+    { 12, 12, CutePocket::StringType, 0, "Lens distance" },
+    { 12, 13, CutePocket::StringType, 0, "Lens filter" },
+    { 12, 14, CutePocket::Int8Type, 1, "Slate mode" },
+    { 12, 15, CutePocket::StringType, 0, "Slate target" },
+};
+
+/**
+ * @brief message
+ * @param e
+ * @param variant selects one of two value sets, alternating them makes every message a change
+ * @return camera control message as sent by the camera, padded to 4 bytes
+ */
+static QByteArray message(const CorpusEntry &e, int variant)
+{
+    namespace Wire = CutePocket::Wire;
+
+    QByteArray payload;
+
+    if (e.type==CutePocket::StringType) {
+        payload=QByteArrayLiteral("Benchmark ")+QByteArray::number(variant);
+    } else {
+        const int size=CutePocket::dataTypeSize(e.type);
+
+        payload.resize(e.count*size);
+        for (int i=0; i<e.count; i++) {
+            const int v=(variant+1)*(i+1)*(e.type==CutePocket::Fixed16Type ? 512 : 1);
+
+            switch (size) {
+            case 1:
+                Wire::store<qint8>(Wire::bytes(payload), i, v);
+                break;
+            case 2:
+                Wire::store<qint16>(Wire::bytes(payload), i*2, v);
+                break;
+            case 4:
+                Wire::store<qint32>(Wire::bytes(payload), i*4, v);
+                break;
+            }
+        }
+    }
+
+    QByteArray msg(CutePocket::MessageHeaderSize+((payload.size()+3) & ~3), '\0');
+
+    msg[0]=char(255);
+    msg[1]=char(4+payload.size());
+    msg[4]=char(e.category);
+    msg[5]=char(e.parameter);
+    msg[6]=char(e.type);
+    msg.replace(CutePocket::MessageHeaderSize, payload.size(), payload);
+
+    return msg;
+}
+
+// Corpus packed into packets of up to 64 bytes, as the camera sends the initial state
+static QList<QByteArray> packedCorpus(int variant)
+{
+    QList<QByteArray> packets;
+    QByteArray packet;
+
+    for (const CorpusEntry &e : corpus) {
+        const QByteArray msg=message(e, variant);
+
+        if (packet.size()+msg.size()>CutePocket::MaxCommandSize) {
+            packets.append(packet);
+            packet.clear();
+        }
+        packet.append(msg);
+    }
+
+    if (!packet.isEmpty())
+        packets.append(packet);
+
+    return packets;
+}
+
+class ProtocolBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void parse_data();
+    void parse();
+
+    void dispatch_data();
+    void dispatch();
+
+    void fanout_data();
+    void fanout();
+
+    void allocations_data();
+    void allocations();
+
+    void encodeInt32();
+    void encodeInt16Pair();
+    void encodeFixed16x4();
+    void convertFixed16();
+    void convertAperture();
+    void convertFixed16x4();
+
+    void setterRoundTrip();
+
+private:
+    void addCorpusRows();
+    int connectReceivers(int receivers);
+
+    CameraDevice *m_device=nullptr;
+    BenchmarkTransport *m_transport=nullptr;
+    QList<NotifyReceiver *> m_receivers;
+
+    // Results are summed here so the compiler can not drop the benchmarked code
+    quint64 m_sink=0;
+};
+
+void ProtocolBenchmark::initTestCase()
+{
+    QLoggingCategory::setFilterRules(QStringLiteral("cutepocket.*.debug=false"));
+}
+
+void ProtocolBenchmark::init()
+{
+    m_device=new CameraDevice();
+    m_transport=new BenchmarkTransport();
+    m_device->setTransport(m_transport);
+}
+
+void ProtocolBenchmark::cleanup()
+{
+    qDeleteAll(m_receivers);
+    m_receivers.clear();
+
+    delete m_device;
+    m_device=nullptr;
+    m_transport=nullptr;
+}
+
+void ProtocolBenchmark::addCorpusRows()
+{
+    QTest::addColumn<QByteArray>("a");
+    QTest::addColumn<QByteArray>("b");
+
+    for (const CorpusEntry &e : corpus)
+        QTest::addRow("%d.%d %s", e.category, e.parameter, e.name) << message(e, 0) << message(e, 1);
+
+    QByteArray a, b;
+    for (const QByteArray &p : packedCorpus(0))
+        a+=p;
+    for (const QByteArray &p : packedCorpus(1))
+        b+=p;
+
+    QTest::newRow("all") << a << b;
+}
+
+void ProtocolBenchmark::parse_data()
+{
+    addCorpusRows();
+}
+
+/**
+ * @brief ProtocolBenchmark::parse
+ *
+ * Message framing and value decoding only, no dispatch.
+ */
+void ProtocolBenchmark::parse()
+{
+    QFETCH(QByteArray, a);
+
+    QBENCHMARK {
+        for (const CutePocket::Message &msg : CutePocket::Messages(a))
+            m_sink+=msg.parameter+msg.integer(0);
+    }
+}
+
+void ProtocolBenchmark::dispatch_data()
+{
+    addCorpusRows();
+}
+
+/**
+ * @brief ProtocolBenchmark::dispatch
+ *
+ * Full incoming path through CameraDevice, alternating values so every message is a change.
+ */
+void ProtocolBenchmark::dispatch()
+{
+    QFETCH(QByteArray, a);
+    QFETCH(QByteArray, b);
+
+    int i=0;
+
+    QBENCHMARK {
+        emit m_transport->controlReceived((i++ & 1) ? b : a);
+    }
+}
+
+int ProtocolBenchmark::connectReceivers(int receivers)
+{
+    const QMetaObject *mo=m_device->metaObject();
+    const QMetaMethod slot=NotifyReceiver::staticMetaObject.method(NotifyReceiver::staticMetaObject.indexOfSlot("changed()"));
+    int connections=0;
+
+    for (int r=0; r<receivers; r++) {
+        NotifyReceiver *receiver=new NotifyReceiver();
+        m_receivers.append(receiver);
+
+        for (int i=0; i<mo->propertyCount(); i++) {
+            const QMetaProperty p=mo->property(i);
+
+            if (p.hasNotifySignal() && QObject::connect(m_device, p.notifySignal(), receiver, slot))
+                connections++;
+        }
+    }
+
+    return connections;
+}
+
+void ProtocolBenchmark::fanout_data()
+{
+    QTest::addColumn<int>("receivers");
+
+    QTest::newRow("0 receivers") << 0;
+    QTest::newRow("1 receiver") << 1;
+    QTest::newRow("8 receivers") << 8;
+    QTest::newRow("32 receivers") << 32;
+}
+
+/**
+ * @brief ProtocolBenchmark::fanout
+ *
+ * Cost of property notifications with receivers connected to every notify signal, as QML bindings are.
+ */
+void ProtocolBenchmark::fanout()
+{
+    QFETCH(int, receivers);
+
+    const QList<QByteArray> a=packedCorpus(0);
+    const QList<QByteArray> b=packedCorpus(1);
+
+    connectReceivers(receivers);
+
+    int i=0;
+
+    QBENCHMARK {
+        for (const QByteArray &p : (i++ & 1) ? b : a)
+            emit m_transport->controlReceived(p);
+    }
+
+    for (const NotifyReceiver *r : std::as_const(m_receivers))
+        m_sink+=r->notifications;
+}
+
+void ProtocolBenchmark::allocations_data()
+{
+    addCorpusRows();
+}
+
+/**
+ * @brief ProtocolBenchmark::allocations
+ *
+ * Heap allocations per dispatched packet, reported as events. Without glibc only
+ * operator new is counted, allocations of Qt containers are missed.
+ */
+void ProtocolBenchmark::allocations()
+{
+    QFETCH(QByteArray, a);
+    QFETCH(QByteArray, b);
+
+    const int iterations=1000;
+
+    // Warm up, first changes allocate the stored strings and the notify counters
+    emit m_transport->controlReceived(a);
+    emit m_transport->controlReceived(b);
+
+    allocationCount.store(0);
+    countingAllocations.store(true);
+
+    for (int i=0; i<iterations; i++)
+        emit m_transport->controlReceived((i & 1) ? b : a);
+
+    countingAllocations.store(false);
+
+    QTest::setBenchmarkResult(double(allocationCount.load())/iterations, QTest::Events);
+}
+
+void ProtocolBenchmark::encodeInt32()
+{
+    volatile qint32 iso=800;
+
+    QBENCHMARK {
+        const CutePocket::Command cmd=CutePocket::CommandBuilder<1, 14, CutePocket::Int32Type>::assign(qint32(iso));
+        m_sink+=cmd.size+cmd.at(8);
+    }
+}
+
+void ProtocolBenchmark::encodeInt16Pair()
+{
+    volatile qint16 wb=5600;
+    volatile qint16 tint=-10;
+
+    QBENCHMARK {
+        const CutePocket::Command cmd=CutePocket::CommandBuilder<1, 2, CutePocket::Int16Type>::assign(qint16(wb), qint16(tint));
+        m_sink+=cmd.size+cmd.at(8);
+    }
+}
+
+void ProtocolBenchmark::encodeFixed16x4()
+{
+    volatile float lift=0.25f;
+
+    QBENCHMARK {
+        const CutePocket::Fixed16x4 v=CutePocket::toFixed16x4({ lift, lift, lift, lift });
+        const CutePocket::Command cmd=CutePocket::CommandBuilder<8, 0, CutePocket::Fixed16Type>::assign(v[0], v[1], v[2], v[3]);
+        m_sink+=cmd.size+cmd.at(8);
+    }
+}
+
+void ProtocolBenchmark::convertFixed16()
+{
+    volatile double v=0.75;
+
+    QBENCHMARK {
+        const qint16 f=CutePocket::toFixed16(v);
+        m_sink+=f+qint64(CutePocket::fromFixed16(f));
+    }
+}
+
+void ProtocolBenchmark::convertAperture()
+{
+    volatile qint16 code=6144;
+
+    QBENCHMARK {
+        m_sink+=qint64(CutePocket::apertureFromFixed16(code)*10.0);
+    }
+}
+
+void ProtocolBenchmark::convertFixed16x4()
+{
+    const QByteArray a=message({ 8, 0, CutePocket::Fixed16Type, 4, "Lift" }, 0);
+
+    QBENCHMARK {
+        const CutePocket::Float4 v=CutePocket::fromFixed16x4(CutePocket::Wire::bytes(a), CutePocket::MessageHeaderSize);
+        m_sink+=qint64(v[0]+v[3]);
+    }
+}
+
+/**
+ * @brief ProtocolBenchmark::setterRoundTrip
+ *
+ * Setter through command build, queue and transport write.
+ */
+void ProtocolBenchmark::setterRoundTrip()
+{
+    int i=0;
+
+    QBENCHMARK {
+        m_device->setISO((i++ & 1) ? 400 : 800);
+    }
+
+    m_sink+=m_transport->written;
+}
+
+QTEST_GUILESS_MAIN(ProtocolBenchmark)
+
+#include "protocolbenchmark.moc"
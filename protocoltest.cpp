@@ -0,0 +1,454 @@
+#include <QtTest>
+
+#include <cmath>
+
+#include "cameracommand.h"
+#include "cameradecoder.h"
+#include "cameratrace.h"
+#include "fixedpoint.h"
+
+/*
+ * Protocol unit tests, no Bluetooth adapter needed.
+ */
+
+// Trace file layout, see CameraTrace
+static const int TraceHeaderSize = 64;
+static const int TraceRecordHeaderSize = 16;
+static const int TraceHeaderCount = 32;
+
+static quint32 align4(quint32 v) { return (v + 3) & ~3u; }
+
+// Payload starting with its record index, padded with the low index byte
+static QByteArray tracePayload(int index, int size)
+{
+    QByteArray p(size, char(index));
+    if (size>=4)
+        qToLittleEndian<qint32>(index, p.data());
+    return p;
+}
+
+class ProtocolTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fixedRoundTrip();
+    void fixedSaturation_data();
+    void fixedSaturation();
+    void fixedRounding_data();
+    void fixedRounding();
+    void aperture();
+
+    void commandBytes_data();
+    void commandBytes();
+    void commandTooLong();
+
+    void decode_data();
+    void decode();
+
+    void traceRoundTrip();
+    void traceWrap();
+    void traceEviction();
+    void traceOversized();
+    void traceCorrupt_data();
+    void traceCorrupt();
+};
+
+// Decoder target storing the last ISO value
+struct DecoderSink
+{
+    int calls=0;
+    qint64 iso=0;
+
+    void handleISO(const CutePocket::Message &msg)
+    {
+        calls++;
+        iso=msg.integer();
+    }
+};
+
+/**
+ * @brief ProtocolTest::fixedRoundTrip
+ *
+ * Every fixed16 value must survive the conversion to double and back.
+ */
+void ProtocolTest::fixedRoundTrip()
+{
+    for (int c=-32768; c<=32767; c++) {
+        const qint16 v=static_cast<qint16>(c);
+
+        if (CutePocket::toFixed16(CutePocket::fromFixed16(v))!=v)
+            QFAIL(qPrintable(QStringLiteral("Round trip failed for %1").arg(c)));
+    }
+
+    QCOMPARE(CutePocket::fromFixed16(CutePocket::toFixed16(CutePocket::FixedMax)), CutePocket::FixedMax);
+    QCOMPARE(CutePocket::fromFixed16(CutePocket::toFixed16(CutePocket::FixedMin)), CutePocket::FixedMin);
+}
+
+void ProtocolTest::fixedSaturation_data()
+{
+    QTest::addColumn<double>("value");
+    QTest::addColumn<int>("fixed");
+
+    QTest::newRow("16") << 16.0 << 32767;
+    QTest::newRow("-16") << -16.0 << -32768;
+    QTest::newRow("max") << CutePocket::FixedMax << 32767;
+    QTest::newRow("above max") << CutePocket::FixedMax+0.25/CutePocket::FixedScale << 32767;
+    QTest::newRow("below min") << CutePocket::FixedMin-0.75/CutePocket::FixedScale << -32768;
+    QTest::newRow("100") << 100.0 << 32767;
+    QTest::newRow("-100") << -100.0 << -32768;
+    QTest::newRow("inf") << qInf() << 32767;
+    QTest::newRow("-inf") << -qInf() << -32768;
+    QTest::newRow("nan") << qQNaN() << 0;
+}
+
+void ProtocolTest::fixedSaturation()
+{
+    QFETCH(double, value);
+    QFETCH(int, fixed);
+
+    QCOMPARE(int(CutePocket::toFixed16(value)), fixed);
+}
+
+void ProtocolTest::fixedRounding_data()
+{
+    QTest::addColumn<double>("lsb");
+    QTest::addColumn<int>("fixed");
+
+    // Values in units of the least significant bit, 1/2048, halfway cases round away from zero
+    QTest::newRow("0.5") << 0.5 << 1;
+    QTest::newRow("-0.5") << -0.5 << -1;
+    QTest::newRow("1.5") << 1.5 << 2;
+    QTest::newRow("-1.5") << -1.5 << -2;
+    QTest::newRow("2.5") << 2.5 << 3;
+    QTest::newRow("-2.5") << -2.5 << -3;
+    QTest::newRow("0.49") << 0.49 << 0;
+    QTest::newRow("-0.49") << -0.49 << 0;
+    QTest::newRow("2047.5") << 2047.5 << 2048;
+    QTest::newRow("32766.5") << 32766.5 << 32767;
+    QTest::newRow("-32767.5") << -32767.5 << -32768;
+}
+
+void ProtocolTest::fixedRounding()
+{
+    QFETCH(double, lsb);
+    QFETCH(int, fixed);
+
+    QCOMPARE(int(CutePocket::toFixed16(lsb/CutePocket::FixedScale)), fixed);
+}
+
+/**
+ * @brief ProtocolTest::aperture
+ *
+ * The table lookup must match the f-number computed directly, sqrt(2^x), for every code.
+ */
+void ProtocolTest::aperture()
+{
+    for (int c=-32768; c<=32767; c++) {
+        const qint16 v=static_cast<qint16>(c);
+        const double expected=std::sqrt(std::pow(2.0, CutePocket::fromFixed16(v)));
+        const double actual=CutePocket::apertureFromFixed16(v);
+
+        if (std::abs(actual-expected)>expected*1e-12)
+            QFAIL(qPrintable(QStringLiteral("Aperture %1: %2, expected %3").arg(c).arg(actual, 0, 'g', 17).arg(expected, 0, 'g', 17)));
+    }
+
+    QCOMPARE(CutePocket::apertureFromFixed16(0), 1.0);
+    QCOMPARE(int(CutePocket::apertureToFixed16(2.0)), 4096);
+    QCOMPARE(int(CutePocket::apertureToFixed16(CutePocket::apertureFromFixed16(7000))), 7000);
+}
+
+void ProtocolTest::commandBytes_data()
+{
+    using namespace CutePocket;
+
+    QTest::addColumn<QByteArray>("command");
+    QTest::addColumn<QByteArray>("expected");
+
+    const auto row=[](const char *name, const Command &cmd, const QByteArray &hex) {
+        QTest::newRow(name) << cmd.toByteArray() << QByteArray::fromHex(hex);
+    };
+
+    row("void", CommandBuilder<0, 1, VoidType>::trigger(),
+        "ff040000 00010000");
+    row("int8", CommandBuilder<10, 1, Int8Type>::assign(qint8(2)),
+        "ff050000 0a010100 02000000");
+    row("int8 display", CommandBuilder<4, 7, Int8Type>::build(DisplayOperation, qint8(1)),
+        "ff050000 04070102 01000000");
+    row("int8 negative", CommandBuilder<1, 13, Int8Type>::offset(qint8(-3)),
+        "ff050000 010d0101 fd000000");
+    row("int16 pair", CommandBuilder<1, 2, Int16Type>::assign(qint16(5600), qint16(-10)),
+        "ff080000 01020200 e015f6ff");
+    row("int32", CommandBuilder<1, 14, Int32Type>::assign(qint32(800)),
+        "ff080000 010e0300 20030000");
+    row("int32 negative", CommandBuilder<1, 12, Int32Type>::assign(qint32(-2)),
+        "ff080000 010c0300 feffffff");
+    row("fixed16", CommandBuilder<0, 0, Fixed16Type>::offset(toFixed16(-0.5)),
+        "ff060000 00008001 00fc0000");
+    row("fixed16 x4", CommandBuilder<8, 0, Fixed16Type>::offset(qint16(1), qint16(2), qint16(3), qint16(-4)),
+        "ff0c0000 08008001 01000200 0300fcff");
+    row("string", CommandBuilder<12, 2, StringType>::assign("A001"),
+        "ff080000 0c020500 41303031");
+    row("string padded", CommandBuilder<12, 2, StringType>::assign("Scene 1"),
+        "ff0b0000 0c020500 5363656e 65203100");
+    row("string empty", CommandBuilder<12, 2, StringType>::assign(""),
+        "ff040000 0c020500");
+    row("string full", CommandBuilder<12, 2, StringType>::assign(QByteArray(56, 'x')),
+        "ff3c0000 0c020500" + QByteArray(56, 'x').toHex());
+}
+
+/**
+ * @brief ProtocolTest::commandBytes
+ *
+ * Built commands must match the wire format byte for byte: header, length byte,
+ * little-endian payload and zero padding to 4 bytes.
+ */
+void ProtocolTest::commandBytes()
+{
+    QFETCH(QByteArray, command);
+    QFETCH(QByteArray, expected);
+
+    QCOMPARE(command.toHex(' '), expected.toHex(' '));
+    QCOMPARE(command.size() % 4, 0);
+}
+
+void ProtocolTest::commandTooLong()
+{
+    const CutePocket::Command cmd=CutePocket::CommandBuilder<12, 2, CutePocket::StringType>::assign(QByteArray(57, 'x'));
+
+    QVERIFY(!cmd.isValid());
+}
+
+void ProtocolTest::decode_data()
+{
+    QTest::addColumn<QByteArray>("packet");
+    QTest::addColumn<int>("calls");
+    QTest::addColumn<int>("errors");
+
+    QTest::newRow("int32") << QByteArray::fromHex("ff080000 010e0300 20030000") << 1 << 0;
+    QTest::newRow("void type") << QByteArray::fromHex("ff040000 010e0000") << 0 << 1;
+    QTest::newRow("int16 type") << QByteArray::fromHex("ff060000 010e0200 20030000") << 0 << 1;
+    QTest::newRow("short payload") << QByteArray::fromHex("ff060000 010e0300 20030000") << 0 << 1;
+    QTest::newRow("other destination") << QByteArray::fromHex("01080000 010e0300 20030000") << 0 << 0;
+    QTest::newRow("unknown parameter") << QByteArray::fromHex("ff080000 011e0300 20030000") << 0 << 0;
+    QTest::newRow("partial header") << QByteArray::fromHex("ff080000 010e0300 20030000 ff04") << 1 << 1;
+    QTest::newRow("short packet") << QByteArray::fromHex("ff080000") << 0 << 1;
+    QTest::newRow("empty") << QByteArray() << 0 << 1;
+    QTest::newRow("length past end") << QByteArray::fromHex("ff0c0000 010e0300 20030000") << 0 << 1;
+}
+
+/**
+ * @brief ProtocolTest::decode
+ *
+ * Only complete messages of the descriptor data type reach the handler, everything
+ * else for a known parameter is counted as an error.
+ */
+void ProtocolTest::decode()
+{
+    using namespace CutePocket;
+
+    QFETCH(QByteArray, packet);
+    QFETCH(int, calls);
+    QFETCH(int, errors);
+
+    static constexpr ParameterDescriptor<DecoderSink> parameters[] = {
+        { 1, 14, Int32Type, 1, "ISO", &DecoderSink::handleISO },
+    };
+    static constexpr ControlDecoder<DecoderSink, std::size(parameters)> decoder(parameters);
+
+    DecoderSink sink;
+    PacketCounters counters;
+
+    decoder.decode(&sink, packet, counters);
+
+    QCOMPARE(sink.calls, calls);
+    QCOMPARE(int(counters.rxErrors.load()), errors);
+
+    if (calls>0)
+        QCOMPARE(sink.iso, qint64(800));
+}
+
+void ProtocolTest::traceRoundTrip()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path=dir.filePath("trace.cptr");
+
+    const QList<CameraTrace::Record> records {
+        { 0, CameraTrace::Rx, CameraTrace::Control, QByteArray::fromHex("ff080000010e030020030000") },
+        { 0, CameraTrace::Tx, CameraTrace::Control, QByteArray::fromHex("0102030405") },
+        { 0, CameraTrace::Rx, CameraTrace::Timecode, QByteArray() },
+        { 0, CameraTrace::Rx, CameraTrace::Status, QByteArray::fromHex("010203") },
+        { 0, CameraTrace::Tx, CameraTrace::Name, QByteArray("Camera") },
+    };
+
+    CameraTrace trace;
+    QVERIFY(trace.open(path, 4096));
+    for (const CameraTrace::Record &r : records)
+        QVERIFY(trace.record(r.direction, r.channel, r.payload));
+    trace.close();
+
+    qint64 startTime=0;
+    const QList<CameraTrace::Record> loaded=CameraTrace::load(path, &startTime);
+
+    QVERIFY(startTime>0);
+    QCOMPARE(loaded.size(), records.size());
+
+    for (int i=0; i<loaded.size(); i++) {
+        QCOMPARE(loaded.at(i).direction, records.at(i).direction);
+        QCOMPARE(loaded.at(i).channel, records.at(i).channel);
+        QCOMPARE(loaded.at(i).payload, records.at(i).payload);
+        if (i>0)
+            QVERIFY(loaded.at(i).timestamp>=loaded.at(i-1).timestamp);
+    }
+}
+
+/**
+ * @brief ProtocolTest::traceWrap
+ *
+ * 116 byte records in a 4096 byte ring: 35 fit before the end, the 36th goes to the start
+ * after a wrap marker and every further record evicts the oldest one.
+ */
+void ProtocolTest::traceWrap()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path=dir.filePath("trace.cptr");
+
+    CameraTrace trace;
+    QVERIFY(trace.open(path, 4096));
+    for (int i=0; i<50; i++)
+        QVERIFY(trace.record(CameraTrace::Rx, CameraTrace::Control, tracePayload(i, 100)));
+    trace.close();
+
+    const QList<CameraTrace::Record> loaded=CameraTrace::load(path);
+
+    QCOMPARE(loaded.size(), 35);
+    for (int i=0; i<loaded.size(); i++)
+        QCOMPARE(loaded.at(i).payload, tracePayload(15+i, 100));
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray data=file.readAll();
+
+    const uchar *d=reinterpret_cast<const uchar *>(data.constData());
+    QCOMPARE(qFromLittleEndian<quint32>(d+TraceHeaderSize+35*116), 0xffffffffu);
+    QCOMPARE(qFromLittleEndian<quint64>(d+TraceHeaderCount), quint64(35));
+}
+
+/**
+ * @brief ProtocolTest::traceEviction
+ *
+ * Random record sizes, the trace must keep a contiguous run of the newest records that
+ * fills the ring up to the space lost at the wrap point.
+ */
+void ProtocolTest::traceEviction()
+{
+    const quint32 capacity=4096;
+    const int maxPayload=200;
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path=dir.filePath("trace.cptr");
+
+    QRandomGenerator rng(1234);
+    QList<int> sizes;
+
+    CameraTrace trace;
+    QVERIFY(trace.open(path, capacity));
+    for (int i=0; i<2000; i++) {
+        sizes.append(rng.bounded(maxPayload));
+        QVERIFY(trace.record(i%2 ? CameraTrace::Tx : CameraTrace::Rx, CameraTrace::Control, tracePayload(i, sizes.last())));
+    }
+    trace.close();
+
+    const QList<CameraTrace::Record> loaded=CameraTrace::load(path);
+    QVERIFY(!loaded.isEmpty());
+
+    const int first=sizes.size()-loaded.size();
+    quint32 used=0;
+
+    for (int i=0; i<loaded.size(); i++) {
+        QCOMPARE(loaded.at(i).payload, tracePayload(first+i, sizes.at(first+i)));
+        used+=TraceRecordHeaderSize+align4(sizes.at(first+i));
+    }
+
+    QVERIFY(used<=capacity);
+    QVERIFY2(used>capacity-2*(TraceRecordHeaderSize+maxPayload), qPrintable(QString::number(used)));
+}
+
+void ProtocolTest::traceOversized()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    CameraTrace trace;
+    QVERIFY(trace.open(dir.filePath("trace.cptr"), 4096));
+
+    // At most half the ring
+    QVERIFY(!trace.record(CameraTrace::Rx, CameraTrace::Control, QByteArray(2048-TraceRecordHeaderSize+1, 'x')));
+    QVERIFY(trace.record(CameraTrace::Rx, CameraTrace::Control, QByteArray(2048-TraceRecordHeaderSize, 'x')));
+}
+
+void ProtocolTest::traceCorrupt_data()
+{
+    QTest::addColumn<int>("offset");
+    QTest::addColumn<QByteArray>("bytes");
+    QTest::addColumn<int>("truncate");
+    QTest::addColumn<int>("records");
+
+    // Five records of 36 bytes, the third one starts at ring offset 72
+    QTest::newRow("intact") << 0 << QByteArray() << -1 << 5;
+    QTest::newRow("magic") << 0 << QByteArray("XXXX") << -1 << 0;
+    QTest::newRow("version") << 4 << QByteArray::fromHex("0200") << -1 << 0;
+    QTest::newRow("capacity") << 8 << QByteArray::fromHex("00001000") << -1 << 0;
+    QTest::newRow("count") << TraceHeaderCount << QByteArray(8, char(0xff)) << -1 << 0;
+    QTest::newRow("record length") << TraceHeaderSize+72 << QByteArray::fromHex("ffffff7f") << -1 << 2;
+    QTest::newRow("truncated ring") << 0 << QByteArray() << TraceHeaderSize+100 << 0;
+    QTest::newRow("truncated header") << 0 << QByteArray() << TraceHeaderSize-1 << 0;
+}
+
+/**
+ * @brief ProtocolTest::traceCorrupt
+ *
+ * Damaged headers must be rejected without reading past the file, a damaged record
+ * ends the trace at the last good record.
+ */
+void ProtocolTest::traceCorrupt()
+{
+    QFETCH(int, offset);
+    QFETCH(QByteArray, bytes);
+    QFETCH(int, truncate);
+    QFETCH(int, records);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path=dir.filePath("trace.cptr");
+
+    {
+        CameraTrace trace;
+        QVERIFY(trace.open(path, 4096));
+        for (int i=0; i<5; i++)
+            QVERIFY(trace.record(CameraTrace::Rx, CameraTrace::Control, tracePayload(i, 20)));
+    }
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    if (truncate>=0) {
+        QVERIFY(file.resize(truncate));
+    } else if (!bytes.isEmpty()) {
+        QVERIFY(file.seek(offset));
+        QCOMPARE(file.write(bytes), bytes.size());
+    }
+    file.close();
+
+    const QList<CameraTrace::Record> loaded=CameraTrace::load(path);
+
+    QCOMPARE(loaded.size(), records);
+    for (int i=0; i<loaded.size(); i++)
+        QCOMPARE(loaded.at(i).payload, tracePayload(i, 20));
+}
+
+QTEST_APPLESS_MAIN(ProtocolTest)
+
+#include "protocoltest.moc"
@@ -0,0 +1,258 @@
+#include "recordsync.h"
+#include "cameradevice.h"
+#include "cameralogging.h"
+
+#include <QDebug>
+
+// Release the staged commands even if a camera never acknowledges its previous write
+static const int ReleaseTimeout = 600;
+
+// Stop waiting for transport mode replies
+static const int ReplyTimeout = 2000;
+
+// Skew samples kept for the statistics, the most recent group records
+static const int MaxHistory = 32;
+
+RecordSync::RecordSync(QObject *parent)
+    : QObject{parent}
+{
+    m_releaseTimeout.setSingleShot(true);
+    m_releaseTimeout.setInterval(ReleaseTimeout);
+    connect(&m_releaseTimeout, &QTimer::timeout, this, &RecordSync::release);
+
+    m_replyTimeout.setSingleShot(true);
+    m_replyTimeout.setInterval(ReplyTimeout);
+    connect(&m_replyTimeout, &QTimer::timeout, this, [this]() {
+        qCWarning(lcTx, "Not all cameras replied to group record");
+        finish();
+    });
+}
+
+bool RecordSync::active() const
+{
+    return m_staged || m_waiting;
+}
+
+/**
+ * @brief RecordSync::trigger
+ * @param cameras
+ * @param record
+ * @return number of cameras the record command was staged on
+ *
+ * Stage the record command on all connected cameras. The commands are held in each
+ * camera queue and released together as soon as no camera has a write in flight.
+ */
+int RecordSync::trigger(const QList<CameraDevice *> &cameras, bool record)
+{
+    if (active()) {
+        qCWarning(lcTx, "Group record already in progress");
+        return 0;
+    }
+
+    m_cameras.clear();
+    m_record=record;
+
+    for (CameraDevice *device : cameras) {
+        if (!device->isConnected())
+            continue;
+
+        device->beginBatch();
+        if (!device->record(record)) {
+            device->commitBatch();
+            continue;
+        }
+
+        Camera c;
+        c.device=device;
+        c.frameRate=device->frameRate();
+        m_cameras.append(c);
+
+        m_connections << connect(device, &CameraDevice::writeIdle, this, &RecordSync::tryRelease);
+        m_connections << connect(device, &CameraDevice::transportModeReceived, this, [this, device]() {
+            replyReceived(device);
+        });
+    }
+
+    if (m_cameras.isEmpty())
+        return 0;
+
+    m_staged=true;
+    emit activeChanged();
+
+    m_releaseTimeout.start();
+    tryRelease();
+
+    return m_cameras.size();
+}
+
+void RecordSync::tryRelease()
+{
+    if (!m_staged)
+        return;
+
+    for (const Camera &c : std::as_const(m_cameras)) {
+        if (c.device && c.device->writeBusy())
+            return;
+    }
+
+    release();
+}
+
+/**
+ * @brief RecordSync::release
+ *
+ * Release the staged record command on all cameras back to back.
+ */
+void RecordSync::release()
+{
+    if (!m_staged)
+        return;
+
+    m_releaseTimeout.stop();
+    m_staged=false;
+    m_waiting=true;
+
+    m_clock.start();
+    for (Camera &c : m_cameras) {
+        if (!c.device)
+            continue;
+
+        c.device->commitBatch();
+        c.released=m_clock.nsecsElapsed();
+    }
+
+    m_replyTimeout.start();
+}
+
+void RecordSync::replyReceived(CameraDevice *device)
+{
+    if (!m_waiting || device->recording()!=m_record)
+        return;
+
+    bool done=true;
+
+    for (Camera &c : m_cameras) {
+        if (c.device==device && c.replied<0) {
+            c.replied=m_clock.nsecsElapsed();
+            c.replyTimecode=device->timecodeFrames();
+        }
+
+        if (c.device && c.replied<0)
+            done=false;
+    }
+
+    if (done)
+        finish();
+}
+
+/**
+ * @brief RecordSync::finish
+ *
+ * Compute the per camera skew. Reply skew is relative to the first camera to report
+ * the new transport mode. Timecode skew is in frames relative to the earliest timecode
+ * seen at reply time, it is approximate (see RecordSync) and only meaningful for jam
+ * synced cameras running at the same frame rate.
+ */
+void RecordSync::finish()
+{
+    m_replyTimeout.stop();
+
+    for (const QMetaObject::Connection &c : std::as_const(m_connections))
+        disconnect(c);
+    m_connections.clear();
+
+    m_waiting=false;
+
+    qint64 firstReply=-1, lastReply=-1;
+    qint64 firstTimecode=-1, lastTimecode=-1;
+    int frameRate=-1;
+    bool timecodeValid=true;
+    int replies=0;
+
+    for (const Camera &c : std::as_const(m_cameras)) {
+        if (c.replied<0)
+            continue;
+
+        replies++;
+
+        if (firstReply<0 || c.replied<firstReply)
+            firstReply=c.replied;
+        if (c.replied>lastReply)
+            lastReply=c.replied;
+
+        if (c.replyTimecode<0 || (frameRate>=0 && c.frameRate!=frameRate)) {
+            timecodeValid=false;
+            continue;
+        }
+        frameRate=c.frameRate;
+
+        if (firstTimecode<0 || c.replyTimecode<firstTimecode)
+            firstTimecode=c.replyTimecode;
+        if (c.replyTimecode>lastTimecode)
+            lastTimecode=c.replyTimecode;
+    }
+
+    m_results.clear();
+    for (const Camera &c : std::as_const(m_cameras)) {
+        QVariantMap r;
+
+        r.insert("name", c.device ? c.device->name() : QString());
+        r.insert("released", c.released/1000000.0);
+        r.insert("latency", c.replied<0 ? -1.0 : c.replied/1000000.0);
+        r.insert("skew", c.replied<0 ? -1.0 : (c.replied-firstReply)/1000000.0);
+        r.insert("timecodeSkew", (c.replied<0 || !timecodeValid) ? -1 : int(c.replyTimecode-firstTimecode));
+
+        m_results.append(r);
+    }
+
+    m_lastTimecodeSkew=(timecodeValid && replies>1) ? int(lastTimecode-firstTimecode) : -1;
+
+    if (replies>1) {
+        if (m_skews.size()>=MaxHistory)
+            m_skews.removeFirst();
+
+        m_skews.append((lastReply-firstReply)/1000000.0);
+    }
+
+    qCInfo(lcTx) << "Group record" << m_record << "replies" << replies << "of" << m_cameras.size()
+                 << "skew" << lastSkew() << "ms" << m_lastTimecodeSkew << "frames";
+
+    emit resultsChanged();
+    emit activeChanged();
+    emit finished();
+}
+
+double RecordSync::lastSkew() const
+{
+    return m_skews.isEmpty() ? 0.0 : m_skews.last();
+}
+
+double RecordSync::meanSkew() const
+{
+    if (m_skews.isEmpty())
+        return 0.0;
+
+    double sum=0.0;
+    for (double s : m_skews)
+        sum+=s;
+
+    return sum/m_skews.size();
+}
+
+double RecordSync::maxSkew() const
+{
+    double max=0.0;
+    for (double s : m_skews)
+        max=qMax(max, s);
+
+    return max;
+}
+
+void RecordSync::resetStats()
+{
+    m_skews.clear();
+    m_lastTimecodeSkew=-1;
+    m_results.clear();
+
+    emit resultsChanged();
+}
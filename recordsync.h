@@ -0,0 +1,94 @@
+#ifndef RECORDSYNC_H
+#define RECORDSYNC_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QPointer>
+#include <QTimer>
+#include <QVariantList>
+#include <QQmlEngine>
+
+class CameraDevice;
+
+/**
+ * @brief The RecordSync class
+ *
+ * Synchronized record start/stop for a group of cameras. The record command is
+ * staged on every camera first and all writes are released in the same event
+ * loop pass once no camera has a write in flight. The transport mode replies
+ * of each camera are then used to measure the start skew.
+ *
+ * The timecode skew compares the last timecode notification of each camera at the
+ * time its reply arrives. Notifications are not aligned with the record start, so it
+ * is approximate and includes the phase difference of the notifications.
+ */
+class RecordSync : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool active READ active NOTIFY activeChanged FINAL)
+    Q_PROPERTY(QVariantList results READ results NOTIFY resultsChanged FINAL)
+    Q_PROPERTY(double lastSkew READ lastSkew NOTIFY resultsChanged FINAL)
+    Q_PROPERTY(double meanSkew READ meanSkew NOTIFY resultsChanged FINAL)
+    Q_PROPERTY(double maxSkew READ maxSkew NOTIFY resultsChanged FINAL)
+    Q_PROPERTY(int lastTimecodeSkew READ lastTimecodeSkew NOTIFY resultsChanged FINAL)
+    Q_PROPERTY(int samples READ samples NOTIFY resultsChanged FINAL)
+    QML_ELEMENT
+    QML_UNCREATABLE("Owned by CameraManager")
+
+public:
+    explicit RecordSync(QObject *parent = nullptr);
+
+    int trigger(const QList<CameraDevice *> &cameras, bool record);
+
+    bool active() const;
+
+    QVariantList results() const { return m_results; }
+
+    double lastSkew() const;
+    double meanSkew() const;
+    double maxSkew() const;
+    int lastTimecodeSkew() const { return m_lastTimecodeSkew; }
+    int samples() const { return m_skews.size(); }
+
+public slots:
+    void resetStats();
+
+signals:
+    void activeChanged();
+    void resultsChanged();
+    void finished();
+
+private:
+    struct Camera {
+        QPointer<CameraDevice> device;
+        qint64 released=-1;
+        qint64 replied=-1;
+        // Last received timecode when the reply arrived, in frames
+        qint64 replyTimecode=-1;
+        int frameRate=0;
+    };
+
+    void tryRelease();
+    void release();
+    void replyReceived(CameraDevice *device);
+    void finish();
+
+    QList<Camera> m_cameras;
+    QList<QMetaObject::Connection> m_connections;
+    bool m_record=false;
+    bool m_staged=false;
+    bool m_waiting=false;
+
+    QElapsedTimer m_clock;
+    QTimer m_releaseTimeout;
+    QTimer m_replyTimeout;
+
+    QVariantList m_results;
+    // Reply spread of each completed trigger in ms
+    QList<double> m_skews;
+    // Approximate timecode spread of the last trigger in frames
+    int m_lastTimecodeSkew=-1;
+};
+
+#endif // RECORDSYNC_H
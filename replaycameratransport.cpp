@@ -0,0 +1,197 @@
+#include "replaycameratransport.h"
+#include "cameralogging.h"
+
+#include <QDebug>
+#include <QFileInfo>
+
+// Records delivered per event loop pass when playing back as fast as possible
+static const int ReplayBurst = 64;
+
+ReplayCameraTransport::ReplayCameraTransport(QObject *parent)
+    : CameraTransport{parent}
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &ReplayCameraTransport::playNext);
+}
+
+void ReplayCameraTransport::connectToDevice(const QBluetoothDeviceInfo &device)
+{
+    Q_UNUSED(device)
+
+    m_records=CameraTrace::load(m_file);
+
+    // Only the camera side of the session is played back
+    m_records.removeIf([](const CameraTrace::Record &r) {
+        return r.direction!=CameraTrace::Rx;
+    });
+
+    if (m_records.isEmpty()) {
+        qCWarning(lcGatt) << "Nothing to replay in" << m_file;
+        emit connectionFailure();
+        return;
+    }
+
+    qCDebug(lcGatt) << "Replaying" << m_records.size() << "records from" << m_file;
+
+    m_connected=true;
+    m_next=0;
+    m_first=m_records.first().timestamp;
+
+    emit connected();
+    emit ready();
+
+    m_clock.start();
+    scheduleNext();
+}
+
+void ReplayCameraTransport::disconnectFromDevice()
+{
+    m_timer.stop();
+    m_records.clear();
+
+    if (!m_connected)
+        return;
+
+    m_connected=false;
+
+    emit disconnected();
+}
+
+bool ReplayCameraTransport::isReady() const
+{
+    return m_connected;
+}
+
+bool ReplayCameraTransport::writeControl(const QByteArray &data, WriteMode mode)
+{
+    Q_UNUSED(data)
+
+    if (!m_connected)
+        return false;
+
+    if (mode==AcknowledgedWrite)
+        QTimer::singleShot(0, this, &ReplayCameraTransport::controlWritten);
+
+    return true;
+}
+
+bool ReplayCameraTransport::writeName(const QByteArray &name)
+{
+    Q_UNUSED(name)
+
+    return m_connected;
+}
+
+QString ReplayCameraTransport::name() const
+{
+    return QStringLiteral("Replay %1").arg(QFileInfo(m_file).fileName());
+}
+
+QString ReplayCameraTransport::address() const
+{
+    return QStringLiteral("00:00:00:00:00:01");
+}
+
+void ReplayCameraTransport::setFile(const QString &file)
+{
+    if (m_file==file)
+        return;
+
+    m_file=file;
+    emit fileChanged();
+}
+
+void ReplayCameraTransport::setSpeed(double speed)
+{
+    if (speed<0.0 || m_speed==speed)
+        return;
+
+    m_speed=speed;
+    emit speedChanged();
+}
+
+void ReplayCameraTransport::setLoop(bool loop)
+{
+    if (m_loop==loop)
+        return;
+
+    m_loop=loop;
+    emit loopChanged();
+}
+
+/**
+ * @brief ReplayCameraTransport::scheduleNext
+ *
+ * Wait until the next record is due relative to the start of playback.
+ */
+void ReplayCameraTransport::scheduleNext()
+{
+    if (m_next>=m_records.size())
+        return;
+
+    if (m_speed==0.0) {
+        m_timer.start(0);
+        return;
+    }
+
+    const qint64 due=(m_records.at(m_next).timestamp-m_first)/m_speed/1000000;
+
+    m_timer.start(qMax<qint64>(0, due-m_clock.elapsed()));
+}
+
+void ReplayCameraTransport::playNext()
+{
+    if (!m_connected)
+        return;
+
+    const qint64 now=m_clock.nsecsElapsed();
+    int delivered=0;
+
+    while (m_next<m_records.size()) {
+        const CameraTrace::Record &r=m_records.at(m_next);
+
+        if (m_speed==0.0) {
+            if (delivered>=ReplayBurst)
+                break;
+        } else if ((r.timestamp-m_first)/m_speed>now) {
+            break;
+        }
+
+        deliver(r);
+        delivered++;
+        m_next++;
+    }
+
+    if (m_next<m_records.size()) {
+        scheduleNext();
+        return;
+    }
+
+    const qint64 elapsed=m_clock.elapsed();
+
+    qCDebug(lcGatt) << "Replayed" << m_records.size() << "records in" << elapsed << "ms";
+    emit replayFinished(m_records.size(), elapsed);
+
+    if (m_loop) {
+        m_next=0;
+        m_clock.start();
+        scheduleNext();
+    }
+}
+
+void ReplayCameraTransport::deliver(const CameraTrace::Record &record)
+{
+    switch (record.channel) {
+    case CameraTrace::Control:
+        emit controlReceived(record.payload);
+        break;
+    case CameraTrace::Timecode:
+        emit timecodeReceived(record.payload);
+        break;
+    case CameraTrace::Status:
+        emit statusReceived(record.payload);
+        break;
+    case CameraTrace::Name:
+        break;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef REPLAYCAMERATRANSPORT_H
+#define REPLAYCAMERATRANSPORT_H
+
+#include "cameratransport.h"
+#include "cameratrace.h"
+
+#include <QElapsedTimer>
+#include <QTimer>
+
+/**
+ * @brief The ReplayCameraTransport class
+ *
+ * Plays back the received notifications of a recorded protocol trace at the
+ * original or an accelerated speed. Writes are acknowledged but otherwise ignored.
+ */
+class ReplayCameraTransport : public CameraTransport
+{
+    Q_OBJECT
+    Q_PROPERTY(QString file READ file WRITE setFile NOTIFY fileChanged FINAL)
+    Q_PROPERTY(double speed READ speed WRITE setSpeed NOTIFY speedChanged FINAL)
+    Q_PROPERTY(bool loop READ loop WRITE setLoop NOTIFY loopChanged FINAL)
+
+public:
+    explicit ReplayCameraTransport(QObject *parent = nullptr);
+
+    void connectToDevice(const QBluetoothDeviceInfo &device) override;
+    void disconnectFromDevice() override;
+
+    bool isReady() const override;
+
+    bool writeControl(const QByteArray &data, WriteMode mode) override;
+    bool writeName(const QByteArray &name) override;
+
+    QString name() const override;
+    QString address() const override;
+
+    QString file() const { return m_file; }
+    void setFile(const QString &file);
+
+    // Playback speed multiplier, 0 plays back as fast as possible
+    double speed() const { return m_speed; }
+    void setSpeed(double speed);
+
+    bool loop() const { return m_loop; }
+    void setLoop(bool loop);
+
+signals:
+    void fileChanged();
+    void speedChanged();
+    void loopChanged();
+
+    void replayFinished(qsizetype records, qint64 elapsed);
+
+private slots:
+    void playNext();
+
+private:
+    void scheduleNext();
+    void deliver(const CameraTrace::Record &record);
+
+    QString m_file;
+    double m_speed=1.0;
+    bool m_loop=false;
+    bool m_connected=false;
+
+    QList<CameraTrace::Record> m_records;
+    qsizetype m_next=0;
+    qint64 m_first=0;
+
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+};
+
+#endif // REPLAYCAMERATRANSPORT_H
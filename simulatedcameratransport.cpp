@@ -0,0 +1,350 @@
+#include "simulatedcameratransport.h"
+
+#include <QDebug>
+#include <QTime>
+
+// Notification rates are timer driven, one per millisecond at most
+static const int MaxRate = 1000;
+
+static QByteArray int16payload(qint16 v)
+{
+    QByteArray p(2, 0);
+    CutePocket::Wire::store<qint16>(CutePocket::Wire::bytes(p), 0, v);
+    return p;
+}
+
+static QByteArray int32payload(qint32 v)
+{
+    QByteArray p(4, 0);
+    CutePocket::Wire::store<qint32>(CutePocket::Wire::bytes(p), 0, v);
+    return p;
+}
+
+static quint8 inttobcd(int v) { return ((v / 10) << 4) | (v % 10); }
+
+SimulatedCameraTransport::SimulatedCameraTransport(QObject *parent)
+    : CameraTransport{parent}
+{
+    m_connectTimer.setSingleShot(true);
+    connect(&m_connectTimer, &QTimer::timeout, this, &SimulatedCameraTransport::deviceConnected);
+
+    connect(&m_timecodeTimer, &QTimer::timeout, this, &SimulatedCameraTransport::sendTimecode);
+    connect(&m_statusTimer, &QTimer::timeout, this, &SimulatedCameraTransport::sendStatus);
+
+    // Initial camera settings, sent as a burst on connect like a real camera does
+    setParameter(0, 2, 0x80, int16payload(8192)); // Aperture f/4
+    setParameter(0, 7, 0x02, int16payload(24)); // Zoom mm
+    setParameter(1, 2, 0x02, int16payload(5600)+int16payload(0)); // WB & Tint
+    setFrameRate(m_frameRate); // Recording format
+    setParameter(1, 12, 0x03, int32payload(50)); // Shutter speed
+    setParameter(1, 14, 0x03, int32payload(800)); // ISO
+    setParameter(4, 7, 0x01, QByteArray(1, 0)); // Time display
+    setParameter(10, 1, 0x01, QByteArray(4, 0)); // Transport mode, speed, slots
+    setParameter(12, 3, 0x01, QByteArray("\x01\x00", 2)); // Take
+    setParameter(12, 5, 0x05, QByteArray("A")); // Camera ID
+    setParameter(8, 0, 0x80, QByteArray(8, 0)); // Lift
+    setParameter(8, 1, 0x80, QByteArray(8, 0)); // Gamma
+    setParameter(8, 2, 0x80, int16payload(2048).repeated(4)); // Gain
+    setParameter(8, 3, 0x80, QByteArray(8, 0)); // Offset
+}
+
+/**
+ * @brief SimulatedCameraTransport::message
+ * @return camera control message with header and padding
+ */
+QByteArray SimulatedCameraTransport::message(quint8 category, quint8 parameter, quint8 type, const QByteArray &payload)
+{
+    QByteArray msg(8, 0);
+    msg[0]=0xff; // Destination
+    msg[1]=4+payload.size(); // Length
+    msg[4]=category;
+    msg[5]=parameter;
+    msg[6]=type;
+    msg[7]=0x00; // Assign
+
+    msg.append(payload);
+    while (msg.size() % 4)
+        msg.append('\0');
+
+    return msg;
+}
+
+void SimulatedCameraTransport::setParameter(quint8 category, quint8 parameter, quint8 type, const QByteArray &payload)
+{
+    m_state.insert((category << 8) | parameter, message(category, parameter, type, payload));
+}
+
+void SimulatedCameraTransport::connectToDevice(const QBluetoothDeviceInfo &device)
+{
+    if (m_connected)
+        return;
+
+    m_name=(device.isValid() && !device.name().isEmpty()) ? device.name() : QStringLiteral("Simulated camera");
+
+    m_connectTimer.start(m_latency);
+}
+
+void SimulatedCameraTransport::deviceConnected()
+{
+    m_connected=true;
+
+    emit connected();
+    emit statusReceived(QByteArray(1, 0x01));
+    emit ready();
+    emit statusReceived(QByteArray(1, 0x03));
+
+    sendInitialState();
+
+    setTimecodeRate(m_timecodeRate);
+    setStatusRate(m_statusRate);
+}
+
+/**
+ * @brief SimulatedCameraTransport::disconnectFromDevice
+ *
+ * Drop the link or cancel a pending connect, like a BLE controller this reports
+ * disconnected() in both cases and does nothing when already disconnected.
+ */
+void SimulatedCameraTransport::disconnectFromDevice()
+{
+    const bool connecting=m_connectTimer.isActive();
+
+    m_connectTimer.stop();
+    m_timecodeTimer.stop();
+    m_statusTimer.stop();
+
+    if (!m_connected && !connecting)
+        return;
+
+    m_connected=false;
+
+    emit disconnected();
+}
+
+bool SimulatedCameraTransport::isReady() const
+{
+    return m_connected;
+}
+
+QString SimulatedCameraTransport::name() const
+{
+    return m_name;
+}
+
+QString SimulatedCameraTransport::address() const
+{
+    return QStringLiteral("00:00:00:00:00:00");
+}
+
+/**
+ * @brief SimulatedCameraTransport::sendInitialState
+ *
+ * Send the current settings packed into 64 byte notifications, several messages per packet.
+ */
+void SimulatedCameraTransport::sendInitialState()
+{
+    QByteArray packet;
+
+    for (const QByteArray &msg : std::as_const(m_state)) {
+        if (packet.size()+msg.size()>64) {
+            emit controlReceived(packet);
+            packet.clear();
+        }
+        packet.append(msg);
+    }
+
+    if (!packet.isEmpty())
+        emit controlReceived(packet);
+}
+
+void SimulatedCameraTransport::sendControl(const QByteArray &data)
+{
+    if (m_connected)
+        emit controlReceived(data);
+}
+
+/**
+ * @brief SimulatedCameraTransport::applyMessage
+ * @param msg
+ *
+ * Apply one camera control message to the simulated state and echo the result back,
+ * like the camera does.
+ */
+void SimulatedCameraTransport::applyMessage(const CutePocket::Message &msg)
+{
+    const quint8 category=msg.category;
+    const quint8 parameter=msg.parameter;
+    const quint8 type=msg.type;
+    const quint8 op=msg.operation;
+    const quint16 key=(category << 8) | parameter;
+
+    QByteArray payload=msg.payload.toByteArray();
+
+    if (type==0x00) {
+        // Triggers are echoed as is
+        sendControl(message(category, parameter, type, payload));
+        return;
+    }
+
+    const QByteArray current=m_state.value(key);
+    const QByteArray value=current.isEmpty() ? QByteArray() : current.mid(8, static_cast<quint8>(current.at(1))-4);
+
+    if (category==10 && parameter==1 && value.size()==4) {
+        // Transport mode command only carries the mode, keep speed & slots
+        payload.append(value.mid(payload.size()));
+    } else if (op==0x01 && value.size()==payload.size() && ((type>=0x01 && type<=0x04) || type==0x80)) {
+        // Offset
+        const int size=type==0x80 ? 2 : qMax(1, 1 << (type-1));
+        for (int p=0; p+size<=payload.size(); p+=size) {
+            const qint64 a=CutePocket::Wire::loadSigned(CutePocket::Wire::bytes(value), p, size)
+                           +CutePocket::Wire::loadSigned(CutePocket::Wire::bytes(payload), p, size);
+            for (int i=0; i<size; i++)
+                payload[p+i]=(a >> (8*i)) & 0xff;
+        }
+    }
+
+    setParameter(category, parameter, type, payload);
+    sendControl(m_state.value(key));
+}
+
+/**
+ * @brief SimulatedCameraTransport::requestConnectionProfile
+ * @param profile
+ * @return
+ *
+ * Report fixed connection parameters for the profile after the simulated latency.
+ */
+bool SimulatedCameraTransport::requestConnectionProfile(ConnectionProfile profile)
+{
+    if (!m_connected)
+        return false;
+
+    QTimer::singleShot(m_latency, this, [this, profile]() {
+        if (!m_connected)
+            return;
+
+        if (profile==ActiveConnection)
+            emit connectionParametersChanged(15.0, 0, 2000);
+        else
+            emit connectionParametersChanged(150.0, 2, 4000);
+    });
+
+    return true;
+}
+
+bool SimulatedCameraTransport::writeControl(const QByteArray &data, WriteMode mode)
+{
+    if (!m_connected)
+        return false;
+
+    QTimer::singleShot(m_latency, this, [this, data, mode]() {
+        if (!m_connected)
+            return;
+
+        if (mode==AcknowledgedWrite)
+            emit controlWritten();
+
+        for (const CutePocket::Message &msg : CutePocket::Messages(data))
+            applyMessage(msg);
+    });
+
+    return true;
+}
+
+bool SimulatedCameraTransport::writeName(const QByteArray &name)
+{
+    if (!m_connected)
+        return false;
+
+    m_name=QString::fromLocal8Bit(name);
+
+    return true;
+}
+
+void SimulatedCameraTransport::sendTimecode()
+{
+    // Timecode follows the time of day, so all simulated cameras are in sync like jam synced cameras
+    const qint64 frames=qint64(QTime::currentTime().msecsSinceStartOfDay())*m_frameRate/1000;
+    const int f=frames % m_frameRate;
+    const int s=(frames / m_frameRate) % 60;
+    const int m=(frames / m_frameRate / 60) % 60;
+    const int h=(frames / m_frameRate / 3600) % 24;
+
+    QByteArray tc(12, 0);
+    tc[8]=inttobcd(f);
+    tc[9]=inttobcd(s);
+    tc[10]=inttobcd(m);
+    tc[11]=inttobcd(h);
+
+    emit timecodeReceived(tc);
+}
+
+void SimulatedCameraTransport::sendStatus()
+{
+    QByteArray status(5, 0);
+    status[0]=m_ticker++;
+    status[1]=100; // Charge
+    status[4]=0x1b; // AC/PSU
+
+    sendControl(message(9, 0, 0x01, status));
+}
+
+int SimulatedCameraTransport::timecodeRate() const
+{
+    return m_timecodeRate;
+}
+
+void SimulatedCameraTransport::setTimecodeRate(int rate)
+{
+    m_timecodeRate=qBound(0, rate, MaxRate);
+
+    if (m_connected && m_timecodeRate>0)
+        m_timecodeTimer.start(1000/m_timecodeRate);
+    else
+        m_timecodeTimer.stop();
+
+    emit timecodeRateChanged();
+}
+
+int SimulatedCameraTransport::statusRate() const
+{
+    return m_statusRate;
+}
+
+void SimulatedCameraTransport::setStatusRate(int rate)
+{
+    m_statusRate=qBound(0, rate, MaxRate);
+
+    if (m_connected && m_statusRate>0)
+        m_statusTimer.start(1000/m_statusRate);
+    else
+        m_statusTimer.stop();
+
+    emit statusRateChanged();
+}
+
+int SimulatedCameraTransport::frameRate() const
+{
+    return m_frameRate;
+}
+
+void SimulatedCameraTransport::setFrameRate(int fps)
+{
+    m_frameRate=qBound(1, fps, 120);
+
+    // File and sensor frame rate, UHD, no flags
+    setParameter(1, 9, 0x02, int16payload(m_frameRate)+int16payload(m_frameRate)+int16payload(3840)+int16payload(2160)+int16payload(0));
+
+    emit frameRateChanged();
+}
+
+int SimulatedCameraTransport::latency() const
+{
+    return m_latency;
+}
+
+void SimulatedCameraTransport::setLatency(int ms)
+{
+    m_latency=qMax(0, ms);
+    emit latencyChanged();
+}
@@ -0,0 +1,91 @@
+#ifndef SIMULATEDCAMERATRANSPORT_H
+#define SIMULATEDCAMERATRANSPORT_H
+
+#include "cameratransport.h"
+#include "cameratypes.h"
+
+#include <QHash>
+#include <QTimer>
+
+/**
+ * @brief The SimulatedCameraTransport class
+ *
+ * In-process camera that answers camera control commands by echoing the
+ * resulting value back and streams timecode and status notifications at
+ * configurable rates. No Bluetooth hardware is needed.
+ */
+class SimulatedCameraTransport : public CameraTransport
+{
+    Q_OBJECT
+    Q_PROPERTY(int timecodeRate READ timecodeRate WRITE setTimecodeRate NOTIFY timecodeRateChanged FINAL)
+    Q_PROPERTY(int statusRate READ statusRate WRITE setStatusRate NOTIFY statusRateChanged FINAL)
+    Q_PROPERTY(int frameRate READ frameRate WRITE setFrameRate NOTIFY frameRateChanged FINAL)
+    Q_PROPERTY(int latency READ latency WRITE setLatency NOTIFY latencyChanged FINAL)
+
+public:
+    explicit SimulatedCameraTransport(QObject *parent = nullptr);
+
+    void connectToDevice(const QBluetoothDeviceInfo &device) override;
+    void disconnectFromDevice() override;
+
+    bool isReady() const override;
+
+    bool writeControl(const QByteArray &data, WriteMode mode) override;
+    bool writeName(const QByteArray &name) override;
+
+    QString name() const override;
+    QString address() const override;
+
+    bool canWriteUnacknowledged() const override { return true; }
+
+    bool requestConnectionProfile(ConnectionProfile profile) override;
+
+    int timecodeRate() const;
+    void setTimecodeRate(int rate);
+
+    int statusRate() const;
+    void setStatusRate(int rate);
+
+    int frameRate() const;
+    void setFrameRate(int fps);
+
+    int latency() const;
+    void setLatency(int ms);
+
+signals:
+    void timecodeRateChanged();
+    void statusRateChanged();
+    void frameRateChanged();
+    void latencyChanged();
+
+private slots:
+    void deviceConnected();
+    void sendTimecode();
+    void sendStatus();
+
+private:
+    static QByteArray message(quint8 category, quint8 parameter, quint8 type, const QByteArray &payload);
+
+    void setParameter(quint8 category, quint8 parameter, quint8 type, const QByteArray &payload);
+    void applyMessage(const CutePocket::Message &msg);
+    void sendInitialState();
+    void sendControl(const QByteArray &data);
+
+    bool m_connected=false;
+    QString m_name;
+
+    int m_timecodeRate=25;
+    int m_statusRate=1;
+    int m_frameRate=25;
+    int m_latency=20;
+    quint8 m_ticker=0;
+
+    QTimer m_connectTimer;
+    QTimer m_timecodeTimer;
+    QTimer m_statusTimer;
+
+    // Current value message for each category/parameter
+    QHash<quint16, QByteArray> m_state;
+};
+
+#endif // SIMULATEDCAMERATRANSPORT_H
@@ -0,0 +1,204 @@
+#include "timecodemodel.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+
+// Stop extrapolating if the camera has not sent a timecode for this long, ms
+static const int StaleTimeout = 1500;
+
+// Never run ahead of the last received timecode by more than this many seconds
+static const int MaxExtrapolation = 1;
+
+static const qint64 SecondsPerDay = 24*60*60;
+
+static const QString InvalidTimecode = QStringLiteral("--:--:--.--");
+
+static void putTwoDigits(QChar *p, int v)
+{
+    p[0]=QChar('0'+v/10);
+    p[1]=QChar('0'+v%10);
+}
+
+TimecodeModel::TimecodeModel(QObject *parent)
+    : QObject{parent}
+    , m_text(InvalidTimecode)
+{
+    m_tick.setTimerType(Qt::PreciseTimer);
+    connect(&m_tick, &QTimer::timeout, this, &TimecodeModel::refresh);
+
+    auto app=qobject_cast<QGuiApplication *>(QCoreApplication::instance());
+    if (app && app->primaryScreen() && app->primaryScreen()->refreshRate()>0)
+        m_refreshRate=app->primaryScreen()->refreshRate();
+
+    m_tick.setInterval(qMax(1, qRound(1000.0/m_refreshRate)));
+}
+
+/**
+ * @brief TimecodeModel::setTimecode
+ * @param hours
+ * @param minutes
+ * @param seconds
+ * @param frames
+ *
+ * Update from a camera timecode notification. Without a known frame rate the
+ * timecode is shown as received.
+ */
+void TimecodeModel::setTimecode(int hours, int minutes, int seconds, int frames)
+{
+    if (!m_valid) {
+        m_valid=true;
+        emit validChanged();
+    }
+
+    if (m_frameRate<=0) {
+        m_tick.stop();
+        setRunning(false);
+        display(hours, minutes, seconds, frames);
+        return;
+    }
+
+    const qint64 received=(qint64(hours)*3600+minutes*60+seconds)*m_frameRate+frames;
+    const bool advancing=m_received>=0 && received!=m_received;
+
+    m_received=received;
+    m_clock.start();
+
+    setRunning(advancing);
+
+    if (!advancing) {
+        m_tick.stop();
+        display(received);
+        return;
+    }
+
+    if (!m_tick.isActive())
+        m_tick.start();
+
+    refresh();
+}
+
+void TimecodeModel::reset()
+{
+    m_tick.stop();
+    m_received=-1;
+    m_displayed=-1;
+
+    setRunning(false);
+
+    if (m_valid) {
+        m_valid=false;
+        emit validChanged();
+    }
+
+    if (m_text!=InvalidTimecode) {
+        m_text=InvalidTimecode;
+        emit textChanged();
+    }
+}
+
+qint64 TimecodeModel::frames() const
+{
+    if (m_received<0)
+        return -1;
+
+    return m_running ? extrapolate() : m_received;
+}
+
+void TimecodeModel::setFrameRate(int fps)
+{
+    if (m_frameRate==fps)
+        return;
+
+    m_frameRate=fps;
+
+    // The frame count of the last timecode is meaningless at the new rate
+    m_tick.stop();
+    m_received=-1;
+    m_displayed=-1;
+    setRunning(false);
+
+    emit frameRateChanged();
+}
+
+void TimecodeModel::setRefreshRate(double hz)
+{
+    if (hz<=0.0 || m_refreshRate==hz)
+        return;
+
+    m_refreshRate=hz;
+    m_tick.setInterval(qMax(1, qRound(1000.0/hz)));
+
+    emit refreshRateChanged();
+}
+
+qint64 TimecodeModel::extrapolate() const
+{
+    const qint64 ahead=qMin<qint64>(m_clock.nsecsElapsed()*m_frameRate/1000000000, qint64(MaxExtrapolation)*m_frameRate);
+
+    return (m_received+ahead) % (SecondsPerDay*m_frameRate);
+}
+
+/**
+ * @brief TimecodeModel::refresh
+ *
+ * Display refresh tick while the timecode is running. A notification slightly behind
+ * the extrapolated timecode holds the display instead of stepping it backwards.
+ */
+void TimecodeModel::refresh()
+{
+    if (m_received<0)
+        return;
+
+    if (m_clock.elapsed()>StaleTimeout) {
+        m_tick.stop();
+        setRunning(false);
+        return;
+    }
+
+    const qint64 frames=extrapolate();
+
+    if (m_displayed>=0 && frames<m_displayed && m_displayed-frames<=m_frameRate/2)
+        return;
+
+    display(frames);
+}
+
+void TimecodeModel::display(qint64 frames)
+{
+    if (frames==m_displayed)
+        return;
+
+    m_displayed=frames;
+
+    const qint64 seconds=frames/m_frameRate;
+
+    display(seconds/3600, (seconds/60)%60, seconds%60, frames%m_frameRate);
+}
+
+void TimecodeModel::display(int hours, int minutes, int seconds, int frames)
+{
+    QChar tc[11];
+
+    putTwoDigits(tc, hours%100);
+    tc[2]=QLatin1Char(':');
+    putTwoDigits(tc+3, minutes%100);
+    tc[5]=QLatin1Char(':');
+    putTwoDigits(tc+6, seconds%100);
+    tc[8]=QLatin1Char('.');
+    putTwoDigits(tc+9, frames%100);
+
+    if (m_text.size()==11 && QStringView(m_text)==QStringView(tc, 11))
+        return;
+
+    m_text=QString(tc, 11);
+    emit textChanged();
+}
+
+void TimecodeModel::setRunning(bool running)
+{
+    if (m_running==running)
+        return;
+
+    m_running=running;
+    emit runningChanged();
+}
@@ -0,0 +1,83 @@
+#ifndef TIMECODEMODEL_H
+#define TIMECODEMODEL_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+#include <QTimer>
+#include <QtQmlIntegration/qqmlintegration.h>
+
+/**
+ * @brief The TimecodeModel class
+ *
+ * Camera timecode as an integer frame count at the camera frame rate. While the
+ * received timecode is advancing it is extrapolated locally from a monotonic clock,
+ * so the display keeps running smoothly between irregular notifications. The display
+ * string is formatted in C++ and updated at most once per display refresh.
+ */
+class TimecodeModel : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+    QML_UNCREATABLE("Owned by CameraDevice")
+    Q_PROPERTY(QString text READ text NOTIFY textChanged FINAL)
+    Q_PROPERTY(bool valid READ valid NOTIFY validChanged FINAL)
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged FINAL)
+    Q_PROPERTY(int frameRate READ frameRate WRITE setFrameRate NOTIFY frameRateChanged FINAL)
+    Q_PROPERTY(double refreshRate READ refreshRate WRITE setRefreshRate NOTIFY refreshRateChanged FINAL)
+
+public:
+    explicit TimecodeModel(QObject *parent = nullptr);
+
+    void setTimecode(int hours, int minutes, int seconds, int frames);
+    void reset();
+
+    QString text() const { return m_text; }
+    bool valid() const { return m_valid; }
+    bool running() const { return m_running; }
+
+    // Extrapolated timecode as frames since midnight, -1 if not known
+    qint64 frames() const;
+
+    // Last received timecode as frames since midnight, -1 if not known
+    qint64 receivedFrames() const { return m_received; }
+
+    int frameRate() const { return m_frameRate; }
+    void setFrameRate(int fps);
+
+    double refreshRate() const { return m_refreshRate; }
+    void setRefreshRate(double hz);
+
+signals:
+    void textChanged();
+    void validChanged();
+    void runningChanged();
+    void frameRateChanged();
+    void refreshRateChanged();
+
+private slots:
+    void refresh();
+
+private:
+    qint64 extrapolate() const;
+    void display(qint64 frames);
+    void display(int hours, int minutes, int seconds, int frames);
+    void setRunning(bool running);
+
+    int m_frameRate=0;
+    double m_refreshRate=60.0;
+
+    bool m_valid=false;
+    bool m_running=false;
+
+    // Last received timecode and when it arrived
+    qint64 m_received=-1;
+    QElapsedTimer m_clock;
+
+    qint64 m_displayed=-1;
+    QString m_text;
+
+    QTimer m_tick;
+};
+
+#endif // TIMECODEMODEL_H